@@ -1,7 +1,9 @@
 #include <iostream>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <deque>
+#include <list>
 #include <map>
 #include <chrono>
 #include <thread>
@@ -9,9 +11,65 @@
 #include <cstdlib>
 #include <climits>
 #include <vector>
+#include <future>
+#include <cctype>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <memory>
+#include <set>
+#include <functional>
+#include <sstream>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <iomanip>
+#include <array>
+#include <fstream>
+#include <cerrno>
+#include <cstdio>
+#ifdef __linux__
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 // Query Processing Components
 
+bool parse_number(const std::string &text, double &value);
+
+// A comparison of a column against a literal, or a literal list for IN, in
+// a WHERE clause.
+struct Predicate
+{
+    std::string column;
+    std::string op; // =, <>, !=, <, <=, >, >=, in
+    std::string value;
+    std::vector<std::string> values; // IN list; value then holds it rendered.
+};
+
+// Analysis of a statement: its kind and the tables it touches, plus the
+// structure of the simple single-table forms the row store can execute.
+struct QueryInfo
+{
+    std::string kind; // Leading keyword: select, insert, update, delete, ...
+    std::vector<std::string> tables;
+
+    bool simple = false;              // Fully understood single-table statement.
+    std::vector<std::string> columns; // SELECT list or INSERT column list; empty means all.
+    std::string aggregate;            // count, sum, min, max or avg for an aggregate SELECT.
+    std::string aggregate_column;     // Aggregated column, "*" for COUNT(*).
+    std::vector<Predicate> where;     // Conjunction of column/literal comparisons.
+    std::vector<std::pair<std::string, std::string>> assignments; // UPDATE ... SET
+    std::vector<std::string> values;  // INSERT ... VALUES, a single row.
+    std::string order_by;             // SELECT ... ORDER BY column, empty if unordered.
+    bool descending = false;
+    long limit = -1;                  // SELECT ... LIMIT, -1 without one.
+    long offset = 0;
+};
+
 class QueryParser
 {
 public:
@@ -22,394 +80,5875 @@ public:
         std::transform(parsed.begin(), parsed.end(), parsed.begin(), ::tolower);
         return parsed;
     }
-};
 
-class QueryOptimizer
-{
-public:
-    std::string optimize(const std::string &parsed_query)
+    // Split a query into tokens. Quoted literals are kept intact and
+    // two-character comparison operators are kept together.
+    std::vector<std::string> tokenize(const std::string &query)
     {
-        // Simulate generating an optimized execution plan.
-        return "OptimizedPlan(" + parsed_query + ")";
+        std::vector<std::string> tokens;
+        size_t i = 0;
+        while (i < query.size())
+        {
+            char c = query[i];
+            if (std::isspace(static_cast<unsigned char>(c)))
+            {
+                i++;
+            }
+            else if (c == '\'' || c == '"')
+            {
+                size_t start = i++;
+                while (i < query.size())
+                {
+                    if (query[i] == c && i + 1 < query.size() && query[i + 1] == c)
+                        i += 2; // Doubled quote inside a literal.
+                    else if (query[i++] == c)
+                        break;
+                }
+                tokens.push_back(query.substr(start, i - start));
+            }
+            else if (std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.' || c == '$')
+            {
+                size_t start = i;
+                while (i < query.size() && (std::isalnum(static_cast<unsigned char>(query[i])) || query[i] == '_' || query[i] == '.' || query[i] == '$'))
+                    i++;
+                tokens.push_back(query.substr(start, i - start));
+            }
+            else
+            {
+                std::string op(1, c);
+                if (i + 1 < query.size())
+                {
+                    std::string two = query.substr(i, 2);
+                    if (two == "<=" || two == ">=" || two == "<>" || two == "!=")
+                        op = two;
+                }
+                tokens.push_back(op);
+                i += op.size();
+            }
+        }
+        return tokens;
     }
-};
 
-class ExecutionEngine
-{
-public:
-    std::string execute(const std::string &plan)
+    // Normalize a query into its fingerprint, the key used by the cache.
+    // Whitespace is canonicalized, keywords and identifiers are lowercased,
+    // quoted literals are preserved and a trailing ';' is dropped.
+    std::string fingerprint(const std::string &query)
     {
-        // Simulate query execution delay.
-        std::this_thread::sleep_for(std::chrono::milliseconds(150 + std::rand() % 150));
-        return "Result for " + plan;
+        std::vector<std::string> tokens = tokenize(query);
+        while (!tokens.empty() && tokens.back() == ";")
+            tokens.pop_back();
+
+        std::string normalized;
+        for (auto &token : tokens)
+        {
+            if (token[0] != '\'' && token[0] != '"')
+                std::transform(token.begin(), token.end(), token.begin(), ::tolower);
+            if (!normalized.empty())
+                normalized += ' ';
+            normalized += token;
+        }
+        return normalized;
     }
-};
 
-class TransactionManager
-{
-public:
-    void begin()
+    // Fingerprint of a query without its LIMIT/OFFSET window, shared by every
+    // page of a paginated query.
+    std::string base_fingerprint(const std::string &query)
     {
-        std::cout << "Transaction started.\n";
+        std::string normalized = fingerprint(query);
+        size_t window = normalized.rfind(" limit ");
+        return window == std::string::npos ? normalized : normalized.substr(0, window);
+    }
+
+    // Extract the statement kind and the tables referenced after FROM, JOIN,
+    // INTO and UPDATE. Tables are returned sorted and deduplicated.
+    QueryInfo analyze(const std::string &query)
+    {
+        QueryInfo info;
+        std::vector<std::string> tokens = tokenize(query);
+        for (auto &token : tokens)
+        {
+            if (token[0] != '\'' && token[0] != '"')
+                std::transform(token.begin(), token.end(), token.begin(), ::tolower);
+        }
+        if (!tokens.empty())
+            info.kind = tokens[0];
+
+        static const std::set<std::string> clause_keywords = {
+            "where", "join", "inner", "left", "right", "cross", "on", "group", "order",
+            "having", "limit", "union", "set", "values", "select", "("};
+        std::set<std::string> tables;
+        for (size_t i = 0; i + 1 < tokens.size(); i++)
+        {
+            const std::string &token = tokens[i];
+            if (token != "from" && token != "join" && token != "into" && token != "update")
+                continue;
+            size_t j = i + 1;
+            while (j < tokens.size() && !clause_keywords.count(tokens[j]))
+            {
+                tables.insert(tokens[j]);
+                // Skip an optional alias up to the next table in a FROM list.
+                while (j < tokens.size() && tokens[j] != "," && tokens[j] != ")" && !clause_keywords.count(tokens[j]))
+                    j++;
+                if (j < tokens.size() && tokens[j] == "," && token == "from")
+                    j++;
+                else
+                    break;
+            }
+        }
+        info.tables.assign(tables.begin(), tables.end());
+        if (info.tables.size() == 1)
+            info.simple = analyze_simple(tokens, info);
+        return info;
     }
-    void commit()
+
+    // Strip the quotes from a literal token and undo doubled quotes.
+    static std::string literal(const std::string &token)
     {
-        std::cout << "Transaction committed.\n";
+        if (token.size() < 2 || (token[0] != '\'' && token[0] != '"'))
+            return token;
+        std::string value;
+        for (size_t i = 1; i + 1 < token.size(); i++)
+        {
+            value += token[i];
+            if (token[i] == token[0] && token[i + 1] == token[0])
+                i++;
+        }
+        return value;
     }
-    void rollback()
+
+private:
+    static bool is_identifier(const std::string &token)
     {
-        std::cout << "Transaction rolled back.\n";
+        return !token.empty() && (std::isalpha(static_cast<unsigned char>(token[0])) || token[0] == '_');
     }
-};
 
-class LockManager
-{
-public:
-    void acquire(const std::string &resource)
+    // Strip a table qualifier such as "o." from a column reference.
+    static std::string column_name(const std::string &token)
     {
-        std::cout << "Lock acquired on " << resource << ".\n";
+        size_t dot = token.rfind('.');
+        return dot == std::string::npos ? token : token.substr(dot + 1);
     }
-    void release(const std::string &resource)
+
+    // Parse the single-table SELECT/INSERT/UPDATE/DELETE forms the row store
+    // understands. Tokens are already lowercased outside literals.
+    bool analyze_simple(const std::vector<std::string> &tokens, QueryInfo &info)
     {
-        std::cout << "Lock released on " << resource << ".\n";
+        static const std::set<std::string> keywords = {
+            "select", "from", "where", "and", "or", "not", "in", "join", "on", "group", "order",
+            "having", "limit", "offset", "union", "set", "values", "into", "by", "as"};
+        static const std::set<std::string> operators = {"=", "<>", "!=", "<", "<=", ">", ">="};
+        static const std::set<std::string> aggregates = {"count", "sum", "min", "max", "avg"};
+
+        size_t pos = 0;
+        auto peek = [&](size_t ahead = 0) -> std::string
+        {
+            return pos + ahead < tokens.size() ? tokens[pos + ahead] : "";
+        };
+        auto accept = [&](const std::string &token)
+        {
+            if (peek() != token)
+                return false;
+            pos++;
+            return true;
+        };
+        auto value_token = [&](std::string &value)
+        {
+            std::string token = peek();
+            if (token.empty() || keywords.count(token) || token == "(" || token == ")" || token == "," || operators.count(token))
+                return false;
+            value = literal(token);
+            pos++;
+            return true;
+        };
+        auto parse_where = [&]()
+        {
+            if (!accept("where"))
+                return true;
+            do
+            {
+                Predicate predicate;
+                if (!is_identifier(peek()) || keywords.count(peek()))
+                    return false;
+                predicate.column = column_name(tokens[pos++]);
+                if (accept("in"))
+                {
+                    predicate.op = "in";
+                    if (!accept("("))
+                        return false;
+                    do
+                    {
+                        std::string value;
+                        if (!value_token(value))
+                            return false;
+                        predicate.values.push_back(value);
+                        predicate.value += (predicate.values.size() > 1 ? "," : "") + value;
+                    } while (accept(","));
+                    if (!accept(")"))
+                        return false;
+                    predicate.value = "(" + predicate.value + ")";
+                    info.where.push_back(predicate);
+                    continue;
+                }
+                if (!operators.count(peek()))
+                    return false;
+                predicate.op = tokens[pos++];
+                if (!value_token(predicate.value))
+                    return false;
+                info.where.push_back(predicate);
+            } while (accept("and"));
+            return true;
+        };
+        auto at_end = [&]()
+        {
+            accept(";");
+            return pos == tokens.size();
+        };
+        auto skip_alias = [&]()
+        {
+            accept("as");
+            if (is_identifier(peek()) && !keywords.count(peek()))
+                pos++;
+        };
+
+        const std::string &table = info.tables[0];
+        if (accept("select"))
+        {
+            if (aggregates.count(peek()) && peek(1) == "(")
+            {
+                info.aggregate = tokens[pos];
+                pos += 2;
+                if (peek() != "*" && !is_identifier(peek()))
+                    return false;
+                info.aggregate_column = column_name(tokens[pos++]);
+                if (!accept(")"))
+                    return false;
+            }
+            else if (!accept("*"))
+            {
+                do
+                {
+                    if (!is_identifier(peek()) || keywords.count(peek()))
+                        return false;
+                    info.columns.push_back(column_name(tokens[pos++]));
+                } while (accept(","));
+            }
+            if (!accept("from") || !accept(table))
+                return false;
+            skip_alias();
+            if (!parse_where())
+                return false;
+            if (accept("order"))
+            {
+                if (!accept("by") || !is_identifier(peek()) || keywords.count(peek()))
+                    return false;
+                info.order_by = column_name(tokens[pos++]);
+                info.descending = accept("desc");
+                if (!info.descending)
+                    accept("asc");
+            }
+            if (accept("limit"))
+            {
+                // LIMIT count [OFFSET skip] or MySQL's LIMIT skip, count.
+                double first, second;
+                if (!parse_number(peek(), first))
+                    return false;
+                pos++;
+                info.limit = static_cast<long>(first);
+                if (accept(",") || accept("offset"))
+                {
+                    bool mysql_form = tokens[pos - 1] == ",";
+                    if (!parse_number(peek(), second))
+                        return false;
+                    pos++;
+                    info.offset = static_cast<long>(mysql_form ? first : second);
+                    info.limit = static_cast<long>(mysql_form ? second : first);
+                }
+                if (info.limit < 0 || info.offset < 0)
+                    return false;
+            }
+            return at_end();
+        }
+        if (accept("insert"))
+        {
+            if (!accept("into") || !accept(table))
+                return false;
+            if (accept("("))
+            {
+                do
+                {
+                    if (!is_identifier(peek()))
+                        return false;
+                    info.columns.push_back(column_name(tokens[pos++]));
+                } while (accept(","));
+                if (!accept(")"))
+                    return false;
+            }
+            if (!accept("values") || !accept("("))
+                return false;
+            do
+            {
+                std::string value;
+                if (!value_token(value))
+                    return false;
+                info.values.push_back(value);
+            } while (accept(","));
+            return accept(")") && at_end() && (info.columns.empty() || info.columns.size() == info.values.size());
+        }
+        if (accept("update"))
+        {
+            if (!accept(table))
+                return false;
+            skip_alias();
+            if (!accept("set"))
+                return false;
+            do
+            {
+                std::string column, value;
+                if (!is_identifier(peek()))
+                    return false;
+                column = column_name(tokens[pos++]);
+                if (!accept("=") || !value_token(value))
+                    return false;
+                info.assignments.push_back({column, value});
+            } while (accept(","));
+            return parse_where() && at_end();
+        }
+        if (accept("delete"))
+        {
+            if (!accept("from") || !accept(table))
+                return false;
+            return parse_where() && at_end();
+        }
+        return false;
     }
 };
 
-// Base Cache Strategy
+// A reusable piece of a plan: an uncorrelated subquery used as an IN list or
+// a scalar value, or a derived table in FROM.
+struct Subplan
+{
+    std::string kind;  // in, scalar or derived
+    std::string text;  // Subquery text without the parentheses.
+    size_t begin = 0;  // Token range [begin, end) of the parenthesized subquery.
+    size_t end = 0;
+};
 
-class CacheStrategy
+class QueryOptimizer
 {
 public:
-    int capacity;
-    std::unordered_map<std::string, std::string> cache;
-    int cache_hits;
-    int cache_misses;
-
-    CacheStrategy(int cap) : capacity(cap), cache_hits(0), cache_misses(0) {}
-    virtual ~CacheStrategy() {}
+    std::string optimize(const std::string &parsed_query)
+    {
+        // Simulate generating an optimized execution plan.
+        return "OptimizedPlan(" + parsed_query + ")";
+    }
 
-    virtual std::string get(const std::string &query)
+    // Identify the subplans of a tokenized query that can be computed once
+    // and recycled. Only the outermost level is returned; subplans nested in
+    // a subplan are found when it is optimized in turn.
+    std::vector<Subplan> find_subplans(const std::vector<std::string> &tokens)
     {
-        if (cache.find(query) != cache.end())
+        static const std::set<std::string> clauses = {
+            "select", "from", "where", "having", "on", "group", "order", "set", "values"};
+        auto lower = [](std::string token)
         {
-            cache_hits++;
-            update(query);
-            return cache[query];
-        }
-        else
+            std::transform(token.begin(), token.end(), token.begin(), ::tolower);
+            return token;
+        };
+
+        std::vector<Subplan> subplans;
+        std::string clause;
+        for (size_t i = 0; i < tokens.size(); i++)
         {
-            cache_misses++;
-            return "";
+            std::string token = lower(tokens[i]);
+            if (clauses.count(token))
+                clause = token;
+            if (token != "(" || i + 1 >= tokens.size() || lower(tokens[i + 1]) != "select")
+                continue;
+
+            size_t close = i;
+            for (int depth = 0; close < tokens.size(); close++)
+            {
+                if (tokens[close] == "(")
+                    depth++;
+                else if (tokens[close] == ")" && --depth == 0)
+                    break;
+            }
+            if (close == tokens.size())
+                break;
+
+            Subplan subplan;
+            std::string previous = i > 0 ? lower(tokens[i - 1]) : "";
+            if (previous == "in")
+                subplan.kind = "in";
+            else if (clause == "from" && (previous == "from" || previous == "join" || previous == ","))
+                subplan.kind = "derived";
+            else
+                subplan.kind = "scalar";
+            for (size_t j = i + 1; j < close; j++)
+            {
+                subplan.text += (j > i + 1 ? " " : "") + tokens[j];
+            }
+            subplan.begin = i;
+            subplan.end = close + 1;
+            subplans.push_back(subplan);
+            i = close;
         }
+        return subplans;
+    }
+};
+
+// Values are compared numerically when both sides are numbers and
+// case-insensitively otherwise, like MySQL's default collation.
+bool parse_number(const std::string &text, double &value)
+{
+    if (text.empty())
+        return false;
+    char *end = nullptr;
+    value = std::strtod(text.c_str(), &end);
+    return end == text.c_str() + text.size();
+}
+
+int compare_values(const std::string &a, const std::string &b)
+{
+    double x, y;
+    if (parse_number(a, x) && parse_number(b, y))
+        return x < y ? -1 : (x > y ? 1 : 0);
+    for (size_t i = 0; i < a.size() && i < b.size(); i++)
+    {
+        int ca = std::tolower(static_cast<unsigned char>(a[i]));
+        int cb = std::tolower(static_cast<unsigned char>(b[i]));
+        if (ca != cb)
+            return ca < cb ? -1 : 1;
+    }
+    return a.size() < b.size() ? -1 : (a.size() > b.size() ? 1 : 0);
+}
+
+bool satisfies(const std::string &value, const Predicate &predicate)
+{
+    if (value == "NULL")
+        return false;
+    if (predicate.op == "in")
+    {
+        return std::any_of(predicate.values.begin(), predicate.values.end(), [&value](const std::string &candidate)
+                           { return compare_values(value, candidate) == 0; });
     }
+    int cmp = compare_values(value, predicate.value);
+    if (predicate.op == "=")
+        return cmp == 0;
+    if (predicate.op == "<>" || predicate.op == "!=")
+        return cmp != 0;
+    if (predicate.op == "<")
+        return cmp < 0;
+    if (predicate.op == "<=")
+        return cmp <= 0;
+    if (predicate.op == ">")
+        return cmp > 0;
+    return cmp >= 0;
+}
+
+std::string format_number(double value)
+{
+    std::ostringstream out;
+    out.precision(15);
+    out << value;
+    return out.str();
+}
+
+// Rows returned by the row store.
+struct ResultSet
+{
+    std::vector<std::string> columns;
+    std::vector<std::vector<std::string>> rows;
+};
+
+// One row written by a DML statement. An empty before image is an insert,
+// an empty after image a delete; both empty marks a write to the table whose
+// rows are unknown. commit_ts is filled in when the change commits.
+struct RowChange
+{
+    std::string table;
+    std::vector<std::string> before;
+    std::vector<std::string> after;
+    unsigned long commit_ts = 0;
+};
+
+// Running state of an aggregate over the rows matching its predicate.
+struct AggregateState
+{
+    long long count = 0;   // Rows counted, non-NULL values for anything but COUNT(*).
+    long long numbers = 0; // Values that SUM/AVG/MIN/MAX aggregated.
+    double sum = 0;
+    double min = 0;
+    double max = 0;
+    bool numeric = true; // False once a non-numeric value was aggregated; only SUM/AVG/MIN/MAX care.
 
-    virtual void put(const std::string &query, const std::string &result)
+    void add(const std::string &value, bool count_star)
     {
-        if (cache.find(query) != cache.end())
+        double number = 0;
+        if (count_star)
         {
-            update(query);
+            count++;
+            return;
         }
-        else
+        if (value == "NULL")
+            return;
+        count++;
+        if (!parse_number(value, number))
         {
-            if (cache.size() >= (size_t)capacity)
-            {
-                evict();
-            }
-            cache[query] = result;
-            admit(query);
+            numeric = false;
+            return;
         }
+        min = numbers == 0 ? number : std::min(min, number);
+        max = numbers == 0 ? number : std::max(max, number);
+        sum += number;
+        numbers++;
     }
 
-    virtual void admit(const std::string &query) = 0;
-    virtual void update(const std::string &query) = 0;
-    virtual void evict() = 0;
-
-    virtual void stats()
+    // Undo add(). Returns false when MIN/MAX are no longer known.
+    bool remove(const std::string &value, bool count_star)
     {
-        std::cout << "Cache Hits: " << cache_hits << "\n";
-        std::cout << "Cache Misses: " << cache_misses << "\n";
-        std::cout << "Current Cache Size: " << cache.size() << "\n";
-        std::cout << "Cached Queries:\n";
-        for (const auto &entry : cache)
+        double number = 0;
+        if (count_star)
         {
-            std::cout << " - " << entry.first << "\n";
+            count--;
+            return true;
         }
+        if (value == "NULL")
+            return true;
+        count--;
+        if (!parse_number(value, number))
+            return false;
+        numbers--;
+        sum -= number;
+        return numbers == 0 || (number != min && number != max);
+    }
+
+    std::string render(const std::string &function) const
+    {
+        if (function == "count")
+            return std::to_string(count);
+        if (numbers == 0)
+            return "NULL";
+        if (function == "sum")
+            return format_number(sum);
+        if (function == "avg")
+            return format_number(sum / numbers);
+        return format_number(function == "min" ? min : max);
     }
 };
 
-// LIRS Cache Implementation (Low Inter-reference Recency)
+// What a statement produced. text is empty if it could not run.
+struct ExecutionResult
+{
+    std::string text;
+    double elapsed_ms = 0;
+    bool structured = false; // Produced by the row store, not the simulated fallback.
+    ResultSet rows;
+    AggregateState aggregate;
+    std::vector<RowChange> changes;
+    unsigned long write_epoch = 0; // TransactionManager::write_epoch() of its tables before it ran.
+};
 
-class LIRSCache : public CacheStrategy
+// Simulated engine backed by a small in-memory row store, so statements on
+// the sample tables return real rows and DML really changes them. Anything
+// the analyzer does not understand falls back to a placeholder result.
+class ExecutionEngine
 {
-    std::deque<std::string> high_interference_list; // High reuse queries
-    std::deque<std::string> low_interference_list;  // Low reuse queries
-    std::unordered_map<std::string, bool> in_high;
+    struct Table
+    {
+        std::vector<std::string> columns;
+        std::vector<std::vector<std::string>> rows;
+    };
 
-public:
-    LIRSCache(int cap) : CacheStrategy(cap) {}
+    std::shared_mutex mutex;
+    std::map<std::string, Table> tables;
+    std::unordered_map<unsigned long, std::map<std::string, Table>> undo; // tx -> before images
+    unsigned long intermediates = 0; // Intermediate tables registered so far.
+    std::set<std::string> intermediate_tables; // Registered and not yet dropped.
 
-    void admit(const std::string &query) override
+    void add_table(const std::string &name, const std::vector<std::string> &columns, const std::vector<std::vector<std::string>> &rows)
     {
-        high_interference_list.push_back(query);
-        in_high[query] = true;
+        tables[name] = Table{columns, rows};
     }
 
-    void update(const std::string &query) override
+    static int find_column(const Table &table, const std::string &column)
     {
-        if (in_high[query])
+        auto it = std::find(table.columns.begin(), table.columns.end(), column);
+        return it == table.columns.end() ? -1 : static_cast<int>(it - table.columns.begin());
+    }
+
+    // Resolve predicate columns; false if one does not exist.
+    static bool bind(const Table &table, const std::vector<Predicate> &where, std::vector<int> &indexes)
+    {
+        for (const auto &predicate : where)
         {
-            // Move to front to make it the most recently used in high-interference list.
-            high_interference_list.erase(std::remove(high_interference_list.begin(), high_interference_list.end(), query), high_interference_list.end());
-            high_interference_list.push_back(query);
+            int index = find_column(table, predicate.column);
+            if (index < 0)
+                return false;
+            indexes.push_back(index);
         }
-        else
+        return true;
+    }
+
+    static bool matches(const std::vector<std::string> &row, const std::vector<Predicate> &where, const std::vector<int> &indexes)
+    {
+        for (size_t i = 0; i < where.size(); i++)
         {
-            // Promote to high-interference list.
-            low_interference_list.erase(std::remove(low_interference_list.begin(), low_interference_list.end(), query), low_interference_list.end());
-            high_interference_list.push_back(query);
-            in_high[query] = true;
+            if (!satisfies(row[indexes[i]], where[i]))
+                return false;
         }
+        return true;
     }
 
-    void evict() override
+    bool run_select(const Table &table, const QueryInfo &info, ExecutionResult &out)
     {
-        std::string victim;
-        if (!high_interference_list.empty())
+        std::vector<int> where_indexes;
+        if (!bind(table, info.where, where_indexes))
+            return false;
+        if (!info.aggregate.empty())
         {
-            victim = high_interference_list.front();
-            high_interference_list.pop_front();
+            bool count_star = info.aggregate_column == "*";
+            int column = count_star ? -1 : find_column(table, info.aggregate_column);
+            if (!count_star && column < 0)
+                return false;
+            for (const auto &row : table.rows)
+            {
+                if (matches(row, info.where, where_indexes))
+                    out.aggregate.add(count_star ? "" : row[column], count_star);
+            }
+            if (!out.aggregate.numeric && info.aggregate != "count")
+                return false;
+            out.rows.columns.push_back(info.aggregate + "(" + info.aggregate_column + ")");
+            out.rows.rows.push_back({out.aggregate.render(info.aggregate)});
+            return true;
         }
-        else if (!low_interference_list.empty())
+
+        std::vector<int> projection;
+        out.rows.columns = info.columns.empty() ? table.columns : info.columns;
+        for (const auto &column : out.rows.columns)
         {
-            victim = low_interference_list.front();
-            low_interference_list.pop_front();
+            int index = find_column(table, column);
+            if (index < 0)
+                return false;
+            projection.push_back(index);
         }
-        else if (!cache.empty())
+        std::vector<const std::vector<std::string> *> selected;
+        for (const auto &row : table.rows)
         {
-            victim = cache.begin()->first;
+            if (matches(row, info.where, where_indexes))
+                selected.push_back(&row);
         }
-        if (!victim.empty())
+        if (!info.order_by.empty())
         {
-            cache.erase(victim);
-            in_high.erase(victim);
-            std::cout << "LIRS Evicted: " << victim << "\n";
+            int order = find_column(table, info.order_by);
+            if (order < 0)
+                return false;
+            std::stable_sort(selected.begin(), selected.end(), [&](const std::vector<std::string> *a, const std::vector<std::string> *b)
+                             { return info.descending ? compare_values((*b)[order], (*a)[order]) < 0
+                                                      : compare_values((*a)[order], (*b)[order]) < 0; });
+        }
+        size_t first = std::min(selected.size(), static_cast<size_t>(info.offset));
+        size_t last = info.limit < 0 ? selected.size() : std::min(selected.size(), first + info.limit);
+        for (size_t i = first; i < last; i++)
+        {
+            std::vector<std::string> projected;
+            for (int index : projection)
+            {
+                projected.push_back((*selected[i])[index]);
+            }
+            out.rows.rows.push_back(projected);
         }
+        return true;
     }
-};
 
-// TinyFLU Cache Implementation (Tiny First Look Up)
+    bool run_write(const std::string &name, Table &table, const QueryInfo &info, unsigned long tx_id, ExecutionResult &out)
+    {
+        std::vector<int> where_indexes;
+        if (!bind(table, info.where, where_indexes))
+            return false;
+        std::vector<int> assigned;
+        for (const auto &assignment : info.assignments)
+        {
+            assigned.push_back(find_column(table, assignment.first));
+            if (assigned.back() < 0)
+                return false;
+        }
+        std::vector<std::string> inserted;
+        if (info.kind == "insert")
+        {
+            if (info.columns.empty() && info.values.size() != table.columns.size())
+                return false;
+            inserted.assign(table.columns.size(), "NULL");
+            for (size_t i = 0; i < info.values.size(); i++)
+            {
+                int index = info.columns.empty() ? static_cast<int>(i) : find_column(table, info.columns[i]);
+                if (index < 0)
+                    return false;
+                inserted[index] = info.values[i];
+            }
+        }
 
-class TinyFLUCache : public CacheStrategy
-{
-    std::deque<std::string> query_queue;
+        // Keep a before image so the transaction can be rolled back.
+        if (tx_id != 0 && !undo[tx_id].count(name))
+            undo[tx_id][name] = table;
 
-public:
-    TinyFLUCache(int cap) : CacheStrategy(cap) {}
+        if (info.kind == "insert")
+        {
+            table.rows.push_back(inserted);
+            out.changes.push_back(RowChange{name, {}, inserted});
+        }
+        else
+        {
+            std::vector<std::vector<std::string>> kept;
+            for (auto &row : table.rows)
+            {
+                if (!matches(row, info.where, where_indexes))
+                {
+                    kept.push_back(row);
+                    continue;
+                }
+                RowChange change{name, row, {}};
+                if (info.kind == "update")
+                {
+                    for (size_t i = 0; i < assigned.size(); i++)
+                    {
+                        row[assigned[i]] = info.assignments[i].second;
+                    }
+                    change.after = row;
+                    kept.push_back(row);
+                }
+                out.changes.push_back(change);
+            }
+            table.rows.swap(kept);
+        }
+        return true;
+    }
 
-    void admit(const std::string &query) override
+public:
+    ExecutionEngine()
     {
-        query_queue.push_back(query);
+        add_table("employees", {"id", "name", "department", "salary"},
+                  {{"1", "Alice", "Engineering", "95000"}, {"2", "Bob", "Sales", "62000"},
+                   {"3", "Carol", "Engineering", "105000"}, {"4", "Dave", "Marketing", "58000"},
+                   {"5", "Eve", "Sales", "71000"}, {"6", "Frank", "Support", "48000"},
+                   {"7", "Grace", "Engineering", "88000"}, {"8", "Heidi", "Marketing", "64000"}});
+        add_table("orders", {"order_id", "product", "amount", "status"},
+                  {{"100", "Laptop", "1500", "shipped"}, {"101", "Phone", "700", "pending"},
+                   {"102", "Monitor", "300", "shipped"}, {"103", "Keyboard", "50", "pending"},
+                   {"104", "Desk", "450", "delivered"}, {"105", "Chair", "200", "shipped"},
+                   {"106", "Tablet", "600", "pending"}, {"107", "Camera", "900", "delivered"},
+                   {"108", "Server", "4200", "shipped"}, {"109", "Printer", "250", "pending"},
+                   {"110", "Router", "120", "delivered"}, {"111", "Workstation", "2800", "shipped"}});
+        add_table("customers", {"id", "name", "city", "status"},
+                  {{"1", "Acme", "New York", "active"}, {"2", "Globex", "Chicago", "active"},
+                   {"3", "Initech", "Los Angeles", "inactive"}, {"4", "Umbrella", "New York", "active"},
+                   {"5", "Hooli", "Houston", "active"}, {"6", "Stark", "Chicago", "inactive"},
+                   {"7", "Wayne", "New York", "active"}, {"8", "Wonka", "Boston", "active"}});
+        add_table("products", {"id", "name", "price", "stock"},
+                  {{"1", "Laptop", "1500", "12"}, {"2", "Phone", "700", "40"}, {"3", "Monitor", "300", "25"},
+                   {"4", "Keyboard", "50", "100"}, {"5", "Mouse", "25", "150"}, {"6", "Desk", "450", "8"}});
+        add_table("sales", {"id", "product", "amount", "region"},
+                  {{"1", "Laptop", "1500", "east"}, {"2", "Phone", "700", "west"}, {"3", "Laptop", "1450", "west"},
+                   {"4", "Monitor", "300", "east"}, {"5", "Phone", "650", "north"}, {"6", "Desk", "450", "south"},
+                   {"7", "Laptop", "1525", "north"}, {"8", "Mouse", "25", "east"}, {"9", "Phone", "720", "east"},
+                   {"10", "Keyboard", "50", "west"}});
+        add_table("users", {"id", "name", "age"},
+                  {{"1", "Alice", "34"}, {"2", "Bob", "19"}, {"3", "Carol", "27"}, {"4", "Dan", "45"},
+                   {"5", "Erin", "22"}, {"6", "Faye", "17"}});
+        add_table("transactions", {"id", "user_id", "amount", "status"},
+                  {{"1", "1", "2500", "completed"}, {"2", "2", "300", "pending"}, {"3", "3", "1200", "completed"},
+                   {"4", "1", "80", "failed"}, {"5", "4", "450", "completed"}, {"6", "5", "1900", "pending"}});
+        add_table("reviews", {"id", "product_id", "rating", "status"},
+                  {{"1", "1", "5", "approved"}, {"2", "2", "3", "pending"}, {"3", "1", "4", "approved"},
+                   {"4", "3", "2", "pending"}, {"5", "4", "5", "approved"}, {"6", "2", "1", "rejected"}});
     }
 
-    void update(const std::string &query) override
+    std::string execute(const std::string &plan)
     {
-        // Move query to the end of the deque, indicating it was recently used.
-        query_queue.erase(std::remove(query_queue.begin(), query_queue.end(), query), query_queue.end());
-        query_queue.push_back(query);
+        // Simulate query execution delay.
+        std::this_thread::sleep_for(std::chrono::milliseconds(150 + std::rand() % 150));
+        return "Result for " + plan;
     }
 
-    void evict() override
+    // Execute a statement on behalf of transaction tx_id (0 for none).
+    ExecutionResult execute(const std::string &plan, const QueryInfo &info, unsigned long tx_id)
     {
-        if (!query_queue.empty())
+        ExecutionResult out;
+        out.text = execute(plan);
+        if (!info.simple)
+            return out;
+
+        bool ran = false;
+        if (info.kind == "select")
         {
-            std::string victim = query_queue.front();
-            query_queue.pop_front();
-            cache.erase(victim);
-            std::cout << "TinyFLU Evicted: " << victim << "\n";
+            std::shared_lock<std::shared_mutex> guard(mutex);
+            auto it = tables.find(info.tables[0]);
+            ran = it != tables.end() && run_select(it->second, info, out);
         }
-    }
+        else
+        {
+            std::unique_lock<std::shared_mutex> guard(mutex);
+            auto it = tables.find(info.tables[0]);
+            ran = it != tables.end() && run_write(it->first, it->second, info, tx_id, out);
+        }
+        if (!ran)
+        {
+            out.rows = ResultSet();
+            out.aggregate = AggregateState();
+            return out;
+        }
+
+        out.structured = true;
+        if (info.kind == "select")
+            out.text = render(plan, out.rows);
+        else
+            out.text = "Query OK, " + std::to_string(out.changes.size()) + " row(s) affected";
+        return out;
+    }
+
+    // Make a materialized intermediate result queryable as a table, under a
+    // fresh name no other table has. The caller drops it with drop_table()
+    // once its statement has run.
+    std::string register_table(const ResultSet &result)
+    {
+        std::unique_lock<std::shared_mutex> guard(mutex);
+        std::string name;
+        do
+        {
+            name = "recycled_" + std::to_string(++intermediates);
+        } while (tables.count(name));
+        tables.emplace(name, Table{result.columns, result.rows});
+        intermediate_tables.insert(name);
+        return name;
+    }
+
+    void drop_table(const std::string &name)
+    {
+        std::unique_lock<std::shared_mutex> guard(mutex);
+        tables.erase(name);
+        intermediate_tables.erase(name);
+    }
+
+    // True for a table register_table() made. Only its own statement sees
+    // it, so it needs no lock.
+    bool intermediate(const std::string &name)
+    {
+        std::shared_lock<std::shared_mutex> guard(mutex);
+        return intermediate_tables.count(name) > 0;
+    }
+
+    int column_index(const std::string &table, const std::string &column)
+    {
+        std::shared_lock<std::shared_mutex> guard(mutex);
+        auto it = tables.find(table);
+        return it == tables.end() ? -1 : find_column(it->second, column);
+    }
+
+    void commit(unsigned long tx_id)
+    {
+        std::unique_lock<std::shared_mutex> guard(mutex);
+        undo.erase(tx_id);
+    }
+
+    void rollback(unsigned long tx_id)
+    {
+        std::unique_lock<std::shared_mutex> guard(mutex);
+        auto it = undo.find(tx_id);
+        if (it == undo.end())
+            return;
+        for (auto &image : it->second)
+        {
+            tables[image.first] = std::move(image.second);
+        }
+        undo.erase(it);
+    }
+
+    static std::string render(const std::string &plan, const ResultSet &result)
+    {
+        std::string text = "Result for " + plan + ": " + std::to_string(result.rows.size()) + " row(s)";
+        if (result.rows.empty())
+            return text;
+        auto join = [](const std::vector<std::string> &fields)
+        {
+            std::string line = "\n  ";
+            for (size_t i = 0; i < fields.size(); i++)
+            {
+                line += (i ? " | " : "") + fields[i];
+            }
+            return line;
+        };
+        text += join(result.columns);
+        for (const auto &row : result.rows)
+        {
+            text += join(row);
+        }
+        return text;
+    }
+};
+
+// Cache state private to one transaction: the tables it has written and the
+// results it computed over them. Only the owning transaction reads these, so
+// its uncommitted writes never touch the shared cache.
+struct TransactionOverlay
+{
+    static const size_t max_results = 64;
+    std::set<std::string> written_tables;
+    std::vector<RowChange> changes;                                  // Published at commit.
+    std::unordered_map<std::string, std::string> results;           // fingerprint -> result
+    std::unordered_map<std::string, std::set<std::string>> readers; // table -> fingerprints
+
+    // True if a read of these tables must see this transaction's own writes.
+    bool covers(const std::vector<std::string> &tables) const
+    {
+        for (const auto &table : tables)
+        {
+            if (written_tables.count(table))
+                return true;
+        }
+        return false;
+    }
+
+    std::string get(const std::string &key) const
+    {
+        auto it = results.find(key);
+        return it == results.end() ? "" : it->second;
+    }
+
+    void put(const std::string &key, const std::string &result, const std::vector<std::string> &tables)
+    {
+        if (results.size() >= max_results)
+            return;
+        results[key] = result;
+        for (const auto &table : tables)
+        {
+            readers[table].insert(key);
+        }
+    }
+
+    // Note a write and drop private results it made stale.
+    void record_write(const std::vector<std::string> &tables, const std::vector<RowChange> &row_changes)
+    {
+        changes.insert(changes.end(), row_changes.begin(), row_changes.end());
+        for (const auto &table : tables)
+        {
+            written_tables.insert(table);
+            auto it = readers.find(table);
+            if (it == readers.end())
+                continue;
+            for (const auto &key : it->second)
+            {
+                results.erase(key);
+            }
+            readers.erase(it);
+        }
+    }
+};
+
+// A transaction's read view: it sees every commit with timestamp <= snapshot.
+struct Transaction
+{
+    unsigned long id = 0;
+    unsigned long snapshot = 0;
+    TransactionOverlay overlay;
+};
+
+// Hands out monotonically increasing commit timestamps and per-transaction
+// read snapshots, and remembers the last commit that wrote each table.
+// Concurrent writing commits are coalesced into groups: whichever committer
+// finds no leader active takes every queued commit, assigns consecutive
+// timestamps, and publishes the whole group with a single on_commit call.
+class TransactionManager
+{
+    struct PendingCommit
+    {
+        const std::set<std::string> *tables;
+        const std::vector<RowChange> *changes;
+        unsigned long commit_ts = 0;
+        bool done = false;
+    };
+
+    std::mutex mutex;
+    std::atomic<unsigned long> clock{0};
+    unsigned long next_id = 1;
+    std::multiset<unsigned long> active_snapshots;
+    std::unordered_map<std::string, unsigned long> last_write;
+    std::unordered_map<unsigned long, std::set<std::string>> writers; // tx -> tables it wrote, until it ends
+    std::unordered_map<std::string, unsigned long> write_epochs;     // table -> writers started or ended on it
+
+    std::mutex group_mutex;
+    std::condition_variable group_cv;
+    std::vector<PendingCommit *> commit_queue;
+    bool leader_active = false;
+    unsigned long commits = 0;
+    unsigned long commit_groups = 0;
+
+    // Runs on the leader without group_mutex held.
+    void publish_group(const std::vector<PendingCommit *> &group)
+    {
+        unsigned long base = clock.load();
+        std::map<std::string, unsigned long> first_write; // table -> earliest commit in group
+        std::vector<RowChange> changes;
+        for (size_t i = 0; i < group.size(); i++)
+        {
+            group[i]->commit_ts = base + i + 1;
+            for (const auto &table : *group[i]->tables)
+            {
+                first_write.emplace(table, group[i]->commit_ts);
+            }
+            for (const auto &change : *group[i]->changes)
+            {
+                changes.push_back(change);
+                changes.back().commit_ts = group[i]->commit_ts;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            for (const auto *pending : group)
+            {
+                for (const auto &table : *pending->tables)
+                {
+                    last_write[table] = pending->commit_ts;
+                }
+            }
+        }
+        if (on_commit)
+            on_commit(first_write, changes);
+        clock.store(base + group.size());
+    }
+
+    void finish(const Transaction &tx)
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        auto it = active_snapshots.find(tx.snapshot);
+        if (it != active_snapshots.end())
+            active_snapshots.erase(it);
+    }
+
+    // Called once tx's writes are published or undone.
+    void end_writes(const Transaction &tx)
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        auto it = writers.find(tx.id);
+        if (it == writers.end())
+            return;
+        for (const auto &table : it->second)
+        {
+            write_epochs[table]++;
+        }
+        writers.erase(it);
+    }
+
+public:
+    // Invoked once per commit group with every table the group wrote, mapped
+    // to the earliest commit timestamp that wrote it, and the group's row
+    // changes in commit order, before those timestamps become visible to new
+    // snapshots.
+    std::function<void(const std::map<std::string, unsigned long> &, const std::vector<RowChange> &)> on_commit;
+
+    Transaction begin()
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        Transaction tx;
+        tx.id = next_id++;
+        tx.snapshot = clock.load();
+        active_snapshots.insert(tx.snapshot);
+        std::cout << "Transaction " << tx.id << " started at snapshot " << tx.snapshot << ".\n";
+        return tx;
+    }
+
+    // Returns the commit timestamp, or 0 for a read-only transaction.
+    unsigned long commit(Transaction &tx)
+    {
+        // A committing transaction reads nothing more, so its snapshot must
+        // not keep the versions its own commit supersedes alive.
+        finish(tx);
+        unsigned long commit_ts = 0;
+        if (!tx.overlay.written_tables.empty())
+        {
+            PendingCommit pending;
+            pending.tables = &tx.overlay.written_tables;
+            pending.changes = &tx.overlay.changes;
+            std::unique_lock<std::mutex> lock(group_mutex);
+            commit_queue.push_back(&pending);
+            while (!pending.done)
+            {
+                if (leader_active)
+                {
+                    group_cv.wait(lock);
+                    continue;
+                }
+                leader_active = true;
+                std::vector<PendingCommit *> group;
+                group.swap(commit_queue);
+                lock.unlock();
+                publish_group(group);
+                lock.lock();
+                for (auto *member : group)
+                {
+                    member->done = true;
+                }
+                commits += group.size();
+                commit_groups++;
+                leader_active = false;
+                group_cv.notify_all();
+            }
+            commit_ts = pending.commit_ts;
+        }
+        end_writes(tx);
+        std::cout << "Transaction " << tx.id << " committed";
+        if (commit_ts != 0)
+            std::cout << " at " << commit_ts;
+        std::cout << ".\n";
+        return commit_ts;
+    }
+
+    void rollback(Transaction &tx)
+    {
+        finish(tx);
+        end_writes(tx);
+        std::cout << "Transaction " << tx.id << " rolled back.\n";
+    }
+
+    // Note that tx is about to change tables in place. Until it commits or
+    // rolls back they hold rows no snapshot may see, so reads of them must
+    // not be cached; see clean_since().
+    void writing(const Transaction &tx, const std::vector<std::string> &tables)
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        auto &written = writers[tx.id];
+        for (const auto &table : tables)
+        {
+            if (written.insert(table).second)
+                write_epochs[table]++;
+        }
+    }
+
+    // Count of writers that started or ended on any of the tables.
+    unsigned long write_epoch(const std::vector<std::string> &tables)
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        unsigned long epoch = 0;
+        for (const auto &table : tables)
+        {
+            auto it = write_epochs.find(table);
+            if (it != write_epochs.end())
+                epoch += it->second;
+        }
+        return epoch;
+    }
+
+    // True if a read of the tables that began at write_epoch() == epoch saw
+    // committed rows only: no writer has started or ended on them since, and
+    // none is open now.
+    bool clean_since(const std::vector<std::string> &tables, unsigned long epoch)
+    {
+        if (write_epoch(tables) != epoch)
+            return false;
+        std::lock_guard<std::mutex> guard(mutex);
+        for (const auto &writer : writers)
+        {
+            for (const auto &table : tables)
+            {
+                if (writer.second.count(table))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    // Timestamp of the latest commit that wrote any of the tables.
+    unsigned long last_write_on(const std::vector<std::string> &tables)
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        unsigned long latest = 0;
+        for (const auto &table : tables)
+        {
+            auto it = last_write.find(table);
+            if (it != last_write.end())
+                latest = std::max(latest, it->second);
+        }
+        return latest;
+    }
+
+    void group_commit_stats()
+    {
+        std::lock_guard<std::mutex> lock(group_mutex);
+        std::cout << "Write Commits: " << commits << " in " << commit_groups << " groups\n";
+    }
+
+    // Oldest snapshot still held by an open transaction, or ULONG_MAX.
+    unsigned long oldest_snapshot()
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        return active_snapshots.empty() ? ULONG_MAX : *active_snapshots.begin();
+    }
+};
+
+enum class LockMode
+{
+    Shared,
+    Exclusive
+};
+
+// Table-level reader/writer lock table. Entries live in a sharded hash so
+// lookups for different tables rarely meet on the same shard mutex, and an
+// uncontended shared lock is granted by a single CAS on the entry's reader
+// count. Contended requests queue FIFO per entry; a request that waits longer
+// than the timeout gives up, which is how deadlocks are broken.
+class LockManager
+{
+    struct LockEntry
+    {
+        std::atomic<int> state{0};   // Number of shared holders, or -1 while held exclusively.
+        std::atomic<int> waiting{0}; // Queued requests; non-zero disables the fast path.
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<unsigned long> queue; // Waiter tickets in arrival order.
+        unsigned long next_ticket = 0;
+    };
+
+    struct Shard
+    {
+        std::shared_mutex mutex;
+        std::unordered_map<std::string, std::unique_ptr<LockEntry>> entries;
+    };
+
+    static const size_t shard_count = 16;
+    Shard shards[shard_count];
+    std::chrono::milliseconds timeout;
+
+    LockEntry &entry_for(const std::string &resource)
+    {
+        Shard &shard = shards[std::hash<std::string>{}(resource) % shard_count];
+        {
+            std::shared_lock<std::shared_mutex> read(shard.mutex);
+            auto it = shard.entries.find(resource);
+            if (it != shard.entries.end())
+                return *it->second;
+        }
+        std::unique_lock<std::shared_mutex> write(shard.mutex);
+        auto &slot = shard.entries[resource];
+        if (!slot)
+            slot.reset(new LockEntry());
+        return *slot;
+    }
+
+    static bool try_grant(LockEntry &entry, LockMode mode)
+    {
+        int current = entry.state.load();
+        if (mode == LockMode::Shared)
+        {
+            while (current >= 0)
+            {
+                if (entry.state.compare_exchange_weak(current, current + 1))
+                    return true;
+            }
+            return false;
+        }
+        current = 0;
+        return entry.state.compare_exchange_strong(current, -1);
+    }
+
+public:
+    LockManager(std::chrono::milliseconds wait_timeout = std::chrono::milliseconds(2000)) : timeout(wait_timeout) {}
+
+    // Returns false if the request timed out; the caller then holds nothing
+    // on this resource and should abort its statement.
+    bool acquire(const std::string &resource, LockMode mode = LockMode::Exclusive)
+    {
+        LockEntry &entry = entry_for(resource);
+        if (entry.waiting.load() == 0 && try_grant(entry, mode))
+            return true;
+
+        std::unique_lock<std::mutex> guard(entry.mutex);
+        unsigned long ticket = entry.next_ticket++;
+        entry.queue.push_back(ticket);
+        entry.waiting++;
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        bool granted = false;
+        while (true)
+        {
+            if (entry.queue.front() == ticket && try_grant(entry, mode))
+            {
+                granted = true;
+                break;
+            }
+            if (entry.cv.wait_until(guard, deadline) == std::cv_status::timeout)
+            {
+                granted = entry.queue.front() == ticket && try_grant(entry, mode);
+                break;
+            }
+        }
+        entry.queue.erase(std::find(entry.queue.begin(), entry.queue.end(), ticket));
+        entry.waiting--;
+        guard.unlock();
+        // The next queued request may now be at the head (e.g. a run of readers).
+        entry.cv.notify_all();
+
+        if (!granted)
+            std::cout << "Lock wait timeout on " << resource << ".\n";
+        return granted;
+    }
+
+    void release(const std::string &resource, LockMode mode = LockMode::Exclusive)
+    {
+        LockEntry &entry = entry_for(resource);
+        if (mode == LockMode::Shared)
+            entry.state.fetch_sub(1);
+        else
+            entry.state.store(0);
+        if (entry.waiting.load() > 0)
+        {
+            // Taking the mutex orders this wakeup after a waiter's last check.
+            std::lock_guard<std::mutex> guard(entry.mutex);
+            entry.cv.notify_all();
+        }
+    }
+};
+
+// Base Cache Strategy
+
+// Snapshot to pass to CacheStrategy::get when any current entry will do.
+const unsigned long latest_snapshot = ULONG_MAX - 1;
+
+// Numeric interval selected by the range/equality predicates on one column.
+struct Interval
+{
+    double low = -HUGE_VAL;
+    double high = HUGE_VAL;
+    bool low_open = false;
+    bool high_open = false;
+
+    bool contains(double value) const
+    {
+        return (value > low || (value == low && !low_open)) && (value < high || (value == high && !high_open));
+    }
+
+    bool contains(const Interval &other) const
+    {
+        bool low_ok = low < other.low || (low == other.low && (!low_open || other.low_open));
+        bool high_ok = high > other.high || (high == other.high && (!high_open || other.high_open));
+        return low_ok && high_ok;
+    }
+};
+
+// True if every non-NULL value of column in rows is a number, or the rows
+// do not have the column. The engine compares anything else as text, which
+// does not order consistently with numeric intervals, so only such results
+// may answer narrower ranges.
+bool numeric_column(const ResultSet &rows, const std::string &column)
+{
+    auto position = std::find(rows.columns.begin(), rows.columns.end(), column);
+    if (position == rows.columns.end())
+        return true;
+    size_t index = position - rows.columns.begin();
+    double value;
+    return std::all_of(rows.rows.begin(), rows.rows.end(), [&](const std::vector<std::string> &row)
+                       { return row[index] == "NULL" || parse_number(row[index], value); });
+}
+
+// Decide how a plain single-table SELECT can reuse cached rows of other
+// queries: any entry in the same group whose rows hold the requested columns
+// answers it by projection. Reads whose predicates all compare one column
+// with numeric literals group by (table, column) and may also be cut from a
+// wider cached range on filter_column; other reads group by their table and
+// canonicalized predicates.
+bool reuse_group(const QueryInfo &info, std::string &group, Interval &range, std::string &filter_column)
+{
+    if (!info.simple || info.kind != "select" || !info.aggregate.empty() || !info.order_by.empty() || info.limit >= 0)
+        return false;
+    range = Interval();
+    filter_column.clear();
+    bool is_range = !info.where.empty();
+    for (const auto &predicate : info.where)
+    {
+        double value;
+        const std::string &op = predicate.op;
+        if (predicate.column != info.where[0].column || op == "<>" || op == "!=" || !parse_number(predicate.value, value))
+        {
+            is_range = false;
+            break;
+        }
+        if ((op == "=" || op == ">" || op == ">=") && (value > range.low || (value == range.low && op == ">")))
+        {
+            range.low = value;
+            range.low_open = op == ">";
+        }
+        if ((op == "=" || op == "<" || op == "<=") && (value < range.high || (value == range.high && op == "<")))
+        {
+            range.high = value;
+            range.high_open = op == "<";
+        }
+    }
+    if (is_range)
+    {
+        filter_column = info.where[0].column;
+        group = "range|" + info.tables[0] + "|" + filter_column;
+        return true;
+    }
+
+    range = Interval();
+    std::vector<std::string> predicates;
+    for (const auto &predicate : info.where)
+    {
+        predicates.push_back(predicate.column + " " + predicate.op + " '" + predicate.value + "'");
+    }
+    std::sort(predicates.begin(), predicates.end());
+    group = "rows|" + info.tables[0];
+    for (const auto &predicate : predicates)
+    {
+        group += "|" + predicate;
+    }
+    return true;
+}
+
+// A cached result, the tables it was computed from, and the commit
+// timestamps [valid_from, valid_to) of the snapshots it is correct for.
+// Plain SELECTs also keep their rows and column schema so other reads in
+// their reuse group can be projected, and for ranges filtered, from them.
+struct CacheEntry
+{
+    std::string result;
+    std::vector<std::string> tables;
+    unsigned long valid_from = 0;
+    unsigned long valid_to = ULONG_MAX;
+    std::shared_ptr<const ResultSet> rows;
+    double cost_ms = 0;       // Measured execution time of the result.
+    bool all_columns = false; // Rows came from SELECT *.
+    bool prefix_complete = false; // For a pagination prefix: rows hold every row.
+    std::string reuse_group;  // Empty unless other reads can be answered from rows.
+    Interval range;
+    uint32_t access_bits = 0; // Policy state kept in the entry itself, see SampledCache.
+    unsigned long last_used = 0; // Strategy access clock at the last hit or insert.
+
+    // Approximate memory held by the entry, excluding its key.
+    size_t size_bytes() const
+    {
+        size_t bytes = sizeof(CacheEntry) + result.size();
+        for (const auto &table : tables)
+        {
+            bytes += table.size();
+        }
+        if (rows)
+        {
+            for (const auto &row : rows->rows)
+            {
+                for (const auto &field : row)
+                {
+                    bytes += field.size() + sizeof(std::string);
+                }
+            }
+        }
+        return bytes;
+    }
+
+    bool has_column(const std::string &column) const
+    {
+        return rows && std::find(rows->columns.begin(), rows->columns.end(), column) != rows->columns.end();
+    }
+
+    // Whether rows can answer a read of columns (empty meaning *) over range,
+    // filtering on filter_column if range is narrower than this entry's.
+    bool can_answer(const Interval &other, const std::vector<std::string> &columns, const std::string &filter_column) const
+    {
+        if (!rows || !range.contains(other))
+            return false;
+        if (columns.empty() ? !all_columns : !std::all_of(columns.begin(), columns.end(), [this](const std::string &column)
+                                                           { return has_column(column); }))
+            return false;
+        return other.contains(range) || has_column(filter_column);
+    }
+
+    bool visible(unsigned long snapshot) const
+    {
+        return valid_from <= snapshot && snapshot < valid_to;
+    }
+};
+
+// Compact per-fingerprint history for cache admission: a count-min sketch
+// of accesses alongside an EWMA of execution cost per counter cell. Both
+// read as the minimum over rows, so collisions can only overstate a query
+// that shares every cell with a hotter or costlier one. Counts are halved
+// periodically so the history follows the current workload.
+class AdmissionSketch
+{
+    static const int depth = 4;
+    static const int width = 512;
+    uint16_t counts[depth][width] = {};
+    float costs[depth][width] = {};
+    size_t increments = 0;
+
+    static size_t cell(size_t hash, int row)
+    {
+        return (hash ^ (hash >> (16 + row * 8))) * (0x9E3779B97F4A7C15ULL + 2 * row) >> 7 & (width - 1);
+    }
+
+public:
+    void record_access(const std::string &query)
+    {
+        size_t hash = std::hash<std::string>{}(query);
+        for (int row = 0; row < depth; row++)
+        {
+            uint16_t &count = counts[row][cell(hash, row)];
+            if (count < UINT16_MAX)
+                count++;
+        }
+        if (++increments >= 8 * width)
+        {
+            for (auto &row : counts)
+            {
+                for (auto &count : row)
+                {
+                    count /= 2;
+                }
+            }
+            increments /= 2;
+        }
+    }
+
+    void record_cost(const std::string &query, double cost_ms)
+    {
+        size_t hash = std::hash<std::string>{}(query);
+        for (int row = 0; row < depth; row++)
+        {
+            float &cost = costs[row][cell(hash, row)];
+            cost = cost == 0 ? (float)cost_ms : 0.7f * cost + 0.3f * (float)cost_ms;
+        }
+    }
+
+    unsigned accesses(const std::string &query) const
+    {
+        size_t hash = std::hash<std::string>{}(query);
+        unsigned result = UINT16_MAX;
+        for (int row = 0; row < depth; row++)
+        {
+            result = std::min<unsigned>(result, counts[row][cell(hash, row)]);
+        }
+        return result;
+    }
+
+    double cost(const std::string &query) const
+    {
+        size_t hash = std::hash<std::string>{}(query);
+        float result = costs[0][cell(hash, 0)];
+        for (int row = 1; row < depth; row++)
+        {
+            result = std::min(result, costs[row][cell(hash, row)]);
+        }
+        return result;
+    }
+};
+
+// Huge Page Backed Cache Memory
+//
+// With millions of entries, a lookup's walk through an index's bucket
+// array and node chain lands on pages scattered over the heap, and TLB
+// misses become a visible share of hit latency. Cache indexes therefore
+// allocate through HugePageAllocator from one HugePageArena, which carves
+// memory out of 2 MB-aligned anonymous regions:
+//   Transparent - regions are marked MADV_HUGEPAGE, so the kernel backs
+//                 them with transparent huge pages where it can;
+//   Hugetlbfs   - regions come from the reserved huge page pool
+//                 (MAP_HUGETLB), falling back to Transparent when the
+//                 pool is empty;
+//   Off         - regions use ordinary pages.
+// The mode applies to regions mapped after it is set. Blocks up to
+// max_pooled bytes come from per-size free lists, in 16-byte steps up to
+// 512 bytes and in powers of two above; larger blocks, such as the bucket
+// arrays of big indexes, get regions of their own and are unmapped when
+// freed. Pooled memory is reused, and release_free() unmaps the pool
+// regions none of whose blocks are in use, so a cache that sheds entries
+// under memory pressure gives the memory back.
+class HugePageArena
+{
+public:
+    enum Mode
+    {
+        Off,
+        Transparent,
+        Hugetlbfs
+    };
+    static const size_t huge_page = size_t(2) << 20;
+    static const size_t max_pooled = size_t(256) << 10;
+
+private:
+    struct Region
+    {
+        char *base;
+        size_t bytes;
+        bool hugetlb;
+    };
+
+    static const int small_classes = 32; // 16..512 bytes
+    static const int classes = small_classes + 9; // then 1 KB..256 KB
+
+    std::mutex mutex;
+    Mode mode = Transparent;
+    std::vector<Region> regions;
+    char *next = nullptr; // Bump pointer into the current pool region.
+    char *end = nullptr;
+    void *free_lists[classes] = {}; // Each free block starts with the next one's address.
+    std::unordered_map<char *, size_t> live; // Pool region base -> blocks in use.
+    size_t hugetlb_fallbacks = 0;
+    size_t released_bytes = 0;
+
+    // Pool regions are one huge page, aligned to one.
+    static char *pool_region(void *block)
+    {
+        return reinterpret_cast<char *>(reinterpret_cast<uintptr_t>(block) & ~(uintptr_t)(huge_page - 1));
+    }
+
+    static int size_class(size_t bytes, size_t &rounded)
+    {
+        if (bytes <= 512)
+        {
+            rounded = std::max<size_t>(16, (bytes + 15) & ~size_t(15));
+            return int(rounded / 16) - 1;
+        }
+        int index = small_classes;
+        for (rounded = 1024; rounded < bytes; rounded *= 2)
+            index++;
+        return index;
+    }
+
+    // Map a region of at least bytes, rounded up to whole huge pages.
+    Region map_region(size_t bytes)
+    {
+        bytes = (bytes + huge_page - 1) / huge_page * huge_page;
+#ifdef __linux__
+        if (mode == Hugetlbfs)
+        {
+            void *mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (mapped != MAP_FAILED)
+                return {static_cast<char *>(mapped), bytes, true};
+            hugetlb_fallbacks++;
+        }
+        // Over-map by a huge page and trim both ends to a 2 MB boundary.
+        void *mapped = mmap(nullptr, bytes + huge_page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapped == MAP_FAILED)
+            throw std::bad_alloc();
+        char *raw = static_cast<char *>(mapped);
+        char *base = reinterpret_cast<char *>((reinterpret_cast<uintptr_t>(raw) + huge_page - 1) & ~(uintptr_t)(huge_page - 1));
+        if (base > raw)
+            munmap(raw, base - raw);
+        munmap(base + bytes, raw + huge_page - base);
+        if (mode != Off)
+            madvise(base, bytes, MADV_HUGEPAGE);
+        return {base, bytes, false};
+#else
+        return {static_cast<char *>(::operator new(bytes, std::align_val_t(huge_page))), bytes, false};
+#endif
+    }
+
+    static void unmap_region(const Region &region)
+    {
+#ifdef __linux__
+        munmap(region.base, region.bytes);
+#else
+        ::operator delete(region.base, std::align_val_t(huge_page));
+#endif
+    }
+
+public:
+    // Never destroyed: caches may still free into it during static destruction.
+    static HugePageArena &instance()
+    {
+        static HugePageArena *arena = new HugePageArena;
+        return *arena;
+    }
+
+    void *allocate(size_t bytes)
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (bytes > max_pooled)
+        {
+            regions.push_back(map_region(bytes));
+            return regions.back().base;
+        }
+        size_t rounded;
+        int index = size_class(bytes, rounded);
+        if (void *block = free_lists[index])
+        {
+            free_lists[index] = *static_cast<void **>(block);
+            live[pool_region(block)]++;
+            return block;
+        }
+        if (next + rounded > end)
+        {
+            regions.push_back(map_region(huge_page));
+            next = regions.back().base;
+            end = next + regions.back().bytes;
+        }
+        void *block = next;
+        next += rounded;
+        live[pool_region(block)]++;
+        return block;
+    }
+
+    void deallocate(void *block, size_t bytes)
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (bytes > max_pooled)
+        {
+            auto region = std::find_if(regions.begin(), regions.end(), [block](const Region &r)
+                                       { return r.base == block; });
+            if (region != regions.end())
+            {
+                unmap_region(*region);
+                regions.erase(region);
+            }
+            return;
+        }
+        size_t rounded;
+        int index = size_class(bytes, rounded);
+        *static_cast<void **>(block) = free_lists[index];
+        free_lists[index] = block;
+        live[pool_region(block)]--;
+    }
+
+    // Unmap the pool regions none of whose blocks are in use, other than the
+    // one being carved up, after unlinking their blocks from the free lists.
+    // Returns the bytes released.
+    size_t release_free()
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        char *current = end ? end - huge_page : nullptr;
+        std::unordered_set<char *> idle;
+        for (const auto &region : live)
+        {
+            if (region.second == 0 && region.first != current)
+                idle.insert(region.first);
+        }
+        if (idle.empty())
+            return 0;
+        for (auto &list : free_lists)
+        {
+            void **link = &list;
+            while (*link)
+            {
+                if (idle.count(pool_region(*link)))
+                    *link = *static_cast<void **>(*link);
+                else
+                    link = static_cast<void **>(*link);
+            }
+        }
+        size_t released = 0;
+        for (auto region = regions.begin(); region != regions.end();)
+        {
+            if (!idle.count(region->base))
+            {
+                ++region;
+                continue;
+            }
+            released += region->bytes;
+            live.erase(region->base);
+            unmap_region(*region);
+            region = regions.erase(region);
+        }
+        released_bytes += released;
+        return released;
+    }
+
+    void set_mode(Mode next_mode)
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        mode = next_mode;
+    }
+
+    // Bytes mapped for cache memory, and how many of them are backed by
+    // huge pages right now: all of a hugetlbfs region, and for the others
+    // the AnonHugePages the kernel reports in /proc/self/smaps.
+    void usage(size_t &mapped, size_t &huge)
+    {
+        std::vector<Region> snapshot;
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            snapshot = regions;
+        }
+        mapped = huge = 0;
+        for (const auto &region : snapshot)
+        {
+            mapped += region.bytes;
+            if (region.hugetlb)
+                huge += region.bytes;
+        }
+        std::ifstream smaps("/proc/self/smaps");
+        std::string line;
+        bool ours = false;
+        while (std::getline(smaps, line))
+        {
+            uintptr_t low, high;
+            if (std::sscanf(line.c_str(), "%lx-%lx ", &low, &high) == 2 && line.find(':') > line.find(' '))
+            {
+                ours = std::any_of(snapshot.begin(), snapshot.end(), [&](const Region &r)
+                                   { return !r.hugetlb && (uintptr_t)r.base < high && (uintptr_t)r.base + r.bytes > low; });
+            }
+            else if (ours && line.compare(0, 14, "AnonHugePages:") == 0)
+            {
+                huge += std::strtoull(line.c_str() + 14, nullptr, 10) * 1024;
+            }
+        }
+    }
+
+    void stats()
+    {
+        size_t mapped, huge;
+        usage(mapped, huge);
+        Mode current;
+        size_t fallbacks, released;
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            current = mode;
+            fallbacks = hugetlb_fallbacks;
+            released = released_bytes;
+        }
+        static const char *names[] = {"off", "transparent", "hugetlbfs"};
+        std::cout << "Cache Index Memory: " << mapped / 1024 << " KB mapped, " << huge / 1024 << " KB on huge pages, "
+                  << released / 1024 << " KB returned (mode " << names[current] << ", " << fallbacks << " hugetlbfs fallbacks)\n";
+    }
+};
+
+// Standard allocator over HugePageArena::instance().
+template <class T>
+struct HugePageAllocator
+{
+    typedef T value_type;
+
+    HugePageAllocator() = default;
+    template <class U>
+    HugePageAllocator(const HugePageAllocator<U> &) {}
+
+    T *allocate(size_t n) { return static_cast<T *>(HugePageArena::instance().allocate(n * sizeof(T))); }
+    void deallocate(T *block, size_t n) { HugePageArena::instance().deallocate(block, n * sizeof(T)); }
+};
+
+template <class T, class U>
+bool operator==(const HugePageAllocator<T> &, const HugePageAllocator<U> &) { return true; }
+template <class T, class U>
+bool operator!=(const HugePageAllocator<T> &, const HugePageAllocator<U> &) { return false; }
+
+// An unordered map whose nodes and bucket array live in huge page memory.
+template <class Value>
+using HugePageMap = std::unordered_map<std::string, Value, std::hash<std::string>, std::equal_to<std::string>,
+                                       HugePageAllocator<std::pair<const std::string, Value>>>;
+
+// Visit up to count entries of an unordered map drawn from random buckets.
+template <class Map, class Visit>
+void sample_buckets(Map &map, std::mt19937 &rng, int count, Visit visit)
+{
+    size_t buckets = map.bucket_count();
+    int sampled = 0;
+    for (int tries = 0; buckets > 0 && sampled < count && tries < count * 10; tries++)
+    {
+        size_t bucket = rng() % buckets;
+        for (auto it = map.begin(bucket); it != map.end(bucket) && sampled < count; ++it, sampled++)
+        {
+            visit(it->first, it->second);
+        }
+    }
+}
+
+// A hash index that grows without a stop-the-world rehash. When a
+// std::unordered_map outgrows its buckets it relinks every node at once,
+// stalling the insert that crossed the threshold for a walk over the whole
+// index. Here the full table instead becomes the draining one, an empty
+// table with twice the buckets takes new entries, and each later insert or
+// erase moves migrate_per_write nodes across, as node handles, so nothing is
+// copied or reallocated. That empties the old table before the new one
+// fills. Lookups check both tables meanwhile; they never move anything, so
+// concurrent readers stay safe.
+template <class Value>
+class IncrementalIndex
+{
+    typedef HugePageMap<Value> Table;
+    Table tables[2]; // [0] takes inserts; [1] drains into it while growing.
+
+    template <bool Const>
+    class basic_iterator
+    {
+        friend class IncrementalIndex;
+        typedef typename std::conditional<Const, const IncrementalIndex, IncrementalIndex>::type Owner;
+        typedef typename std::conditional<Const, typename Table::const_iterator, typename Table::iterator>::type Inner;
+
+        Owner *owner;
+        int table; // 2 once past the end.
+        Inner inner;
+
+        basic_iterator(Owner *o, int t, Inner i) : owner(o), table(t), inner(i) { skip_empty(); }
+        void skip_empty()
+        {
+            while (table < 2 && inner == owner->tables[table].end())
+            {
+                if (++table < 2)
+                    inner = owner->tables[table].begin();
+            }
+        }
+
+    public:
+        basic_iterator() : owner(nullptr), table(2), inner() {}
+        operator basic_iterator<true>() const { return basic_iterator<true>(owner, table, inner); }
+        auto &operator*() const { return *inner; }
+        auto *operator->() const { return &*inner; }
+        basic_iterator &operator++()
+        {
+            ++inner;
+            skip_empty();
+            return *this;
+        }
+        bool operator==(const basic_iterator &other) const { return table == other.table && (table == 2 || inner == other.inner); }
+        bool operator!=(const basic_iterator &other) const { return !(*this == other); }
+    };
+
+    // Start draining once the insert table is at its load limit.
+    void grow_if_full()
+    {
+        Table &fresh = tables[0];
+        if (fresh.empty() || !tables[1].empty() || fresh.size() + 1 <= fresh.bucket_count() * fresh.max_load_factor())
+            return;
+        tables[1].swap(fresh);
+        fresh.reserve(std::max<size_t>(16, tables[1].size() * 2));
+        growths++;
+    }
+
+    void migrate(int count)
+    {
+        for (; count > 0 && !tables[1].empty(); count--)
+            tables[0].insert(tables[1].extract(tables[1].begin()));
+    }
+
+public:
+    typedef basic_iterator<false> iterator;
+    typedef basic_iterator<true> const_iterator;
+    static const int migrate_per_write = 4;
+    long growths = 0;
+
+    iterator begin() { return iterator(this, 0, tables[0].begin()); }
+    iterator end() { return iterator(); }
+    const_iterator begin() const { return const_iterator(this, 0, tables[0].begin()); }
+    const_iterator end() const { return const_iterator(); }
+
+    size_t size() const { return tables[0].size() + tables[1].size(); }
+    bool empty() const { return size() == 0; }
+    bool growing() const { return !tables[1].empty(); }
+
+    iterator find(const std::string &key)
+    {
+        auto it = tables[0].find(key);
+        if (it != tables[0].end())
+            return iterator(this, 0, it);
+        it = tables[1].find(key);
+        return it != tables[1].end() ? iterator(this, 1, it) : end();
+    }
+    const_iterator find(const std::string &key) const
+    {
+        auto it = tables[0].find(key);
+        if (it != tables[0].end())
+            return const_iterator(this, 0, it);
+        it = tables[1].find(key);
+        return it != tables[1].end() ? const_iterator(this, 1, it) : end();
+    }
+    size_t count(const std::string &key) const { return tables[0].count(key) + tables[1].count(key); }
+
+    // Existing keys are returned where they are, so a hit moves nothing.
+    Value &operator[](const std::string &key)
+    {
+        auto it = find(key);
+        if (it != end())
+            return it->second;
+        grow_if_full();
+        migrate(migrate_per_write);
+        return tables[0][key];
+    }
+
+    void erase(iterator position)
+    {
+        tables[position.table].erase(position.inner);
+        migrate(migrate_per_write);
+    }
+
+    void swap(IncrementalIndex &other)
+    {
+        tables[0].swap(other.tables[0]);
+        tables[1].swap(other.tables[1]);
+        std::swap(growths, other.growths);
+    }
+
+    // Visit up to count entries drawn from random buckets of either table,
+    // in proportion to their sizes.
+    template <class Visit>
+    void sample(std::mt19937 &rng, int count, Visit visit)
+    {
+        int draining = tables[1].empty() ? 0 : (int)std::lround(double(count) * tables[1].size() / size());
+        sample_buckets(tables[0], rng, count - draining, visit);
+        if (draining > 0)
+            sample_buckets(tables[1], rng, draining, visit);
+    }
+};
+
+class CacheStrategy
+{
+public:
+    int capacity;
+    IncrementalIndex<CacheEntry> cache;
+    std::unordered_map<std::string, std::set<std::string>> table_index; // table -> cached queries
+    std::unordered_map<std::string, std::multimap<double, std::string>> reuse_index; // group -> range low bound -> query
+    int cache_hits;
+    int cache_misses;
+    int subsumed_hits;    // Hits answered from another query's cached rows.
+    int entries_absorbed; // Entries dropped because a new one subsumes them.
+    double saved_ms;      // Execution time the hits avoided.
+
+    // Cost-based admission: once the cache is full, a new entry whose
+    // expected saved time per byte falls below admission_ratio times the
+    // running average over recent candidates is not cached at all.
+    AdmissionSketch history;
+    double admission_ratio;
+    double average_value;
+    int entries_rejected;
+    bool verbose; // Print evictions as they happen.
+    unsigned long access_clock;
+
+    // Fill levels, as fractions of the capacity, for background eviction:
+    // once the cache fills past high_watermark a maintenance thread evicts
+    // in batches down to low_watermark (see DatabaseSystem::maintain()).
+    // put() evicts inline only at the capacity itself, as a fallback for
+    // when inserts outrun the maintenance thread.
+    double low_watermark = 0.9;
+    double high_watermark = 0.97;
+    long inline_evictions = 0;
+    long background_evictions = 0;
+
+    // Entries adopted from a previous strategy that this policy has not been
+    // told about yet, coldest first. They are served from the index all the
+    // same; migrate_some() feeds them to the policy a few at a time.
+    std::deque<std::string> migration_order;
+    std::unordered_set<std::string> unmigrated;
+    int migration_batch = 8;
+    std::vector<std::string> shared_hit_log; // Hits get_shared() has not counted yet.
+    long unlogged_hits = 0;                  // Hits past the log's bound, counted but not recorded.
+    double unlogged_saved_ms = 0;
+    std::mutex shared_hit_mutex;             // Guards the log and the unlogged counters.
+    static const size_t max_shared_hit_log = 1024;
+
+    CacheStrategy(int cap) : capacity(cap), cache_hits(0), cache_misses(0), subsumed_hits(0), entries_absorbed(0), saved_ms(0),
+                             admission_ratio(0.5), average_value(0), entries_rejected(0), verbose(true), access_clock(0) {}
+    virtual ~CacheStrategy() {}
+
+    void record_hit(const std::string &query)
+    {
+        count_hit(query, cache[query]);
+        touch(query);
+    }
+
+    void count_hit(const std::string &query, CacheEntry &entry)
+    {
+        cache_hits++;
+        saved_ms += entry.cost_ms;
+        entry.last_used = ++access_clock;
+        history.record_access(query);
+    }
+
+    // A get() for callers holding only a shared lock, for policies with
+    // shared_hits(). The policy hears about the hit at once, but the
+    // counters and access history are written by apply_shared_hits() under
+    // the exclusive lock. The log is bounded: past max_shared_hit_log hits,
+    // until the next exclusive operation drains it, hits are only counted
+    // and miss the access history. Adopted entries the policy has not seen
+    // yet are left to get(). Returns an empty string on a miss without
+    // counting it.
+    std::string get_shared(const std::string &query, unsigned long snapshot)
+    {
+        auto it = cache.find(query);
+        if (it == cache.end() || !it->second.visible(snapshot) || unmigrated.count(query))
+            return "";
+        update(query);
+        std::lock_guard<std::mutex> guard(shared_hit_mutex);
+        if (shared_hit_log.size() < max_shared_hit_log)
+        {
+            shared_hit_log.push_back(query);
+        }
+        else
+        {
+            unlogged_hits++;
+            unlogged_saved_ms += it->second.cost_ms;
+        }
+        return it->second.result;
+    }
+
+    // Count the hits get_shared() logged. Requires the exclusive lock.
+    void apply_shared_hits()
+    {
+        std::vector<std::string> log;
+        {
+            std::lock_guard<std::mutex> guard(shared_hit_mutex);
+            log.swap(shared_hit_log);
+            cache_hits += unlogged_hits;
+            saved_ms += unlogged_saved_ms;
+            unlogged_hits = 0;
+            unlogged_saved_ms = 0;
+        }
+        for (const auto &query : log)
+        {
+            auto it = cache.find(query);
+            if (it != cache.end())
+                count_hit(query, it->second);
+        }
+    }
+
+    // Catch up before an exclusive operation: count the shared hits and
+    // feed the policy a few adopted entries.
+    void catch_up()
+    {
+        apply_shared_hits();
+        migrate_some();
+    }
+
+    // Swap an entry for a new version of itself, such as a grown
+    // pagination prefix. It goes back through put(), so admission, weights
+    // and eviction see its new size.
+    void replace(const std::string &query, CacheEntry entry)
+    {
+        erase_entry(query);
+        forget(query);
+        put(query, std::move(entry));
+    }
+
+    // Tell the policy about a hit, or about the entry itself if it is an
+    // adopted one the policy has not seen yet.
+    void touch(const std::string &query)
+    {
+        if (unmigrated.erase(query))
+            admit(query);
+        else
+            update(query);
+    }
+
+    // Take over the entries of the strategy being replaced instead of
+    // starting cold. The index moves across at once, so every entry keeps
+    // being served; the policy learns about them incrementally, coldest
+    // first by last use, and each one is followed by up to three replayed
+    // hits according to the carried-over frequency sketch, so recency and
+    // frequency policies alike rebuild an ordering close to their own.
+    void adopt(CacheStrategy &previous)
+    {
+        previous.apply_shared_hits();
+        cache.swap(previous.cache);
+        table_index.swap(previous.table_index);
+        reuse_index.swap(previous.reuse_index);
+        history = previous.history;
+        average_value = previous.average_value;
+        access_clock = previous.access_clock;
+
+        std::vector<std::pair<unsigned long, std::string>> order;
+        for (const auto &entry : cache)
+        {
+            order.push_back({entry.second.last_used, entry.first});
+        }
+        std::sort(order.begin(), order.end());
+        migration_order.clear();
+        unmigrated.clear();
+        for (const auto &key : order)
+        {
+            migration_order.push_back(key.second);
+            unmigrated.insert(key.second);
+            adopted(key.second);
+        }
+        while (fill() > 1.0 && drop_unmigrated())
+            ;
+    }
+
+    // Account for an adopted entry before the policy itself admits it, so
+    // fill() counts the whole index from the start.
+    virtual void adopted(const std::string &) {}
+
+    // Feed up to migration_batch adopted entries to the policy.
+    void migrate_some()
+    {
+        for (int fed = 0; fed < migration_batch && !migration_order.empty();)
+        {
+            std::string key = migration_order.front();
+            migration_order.pop_front();
+            if (!unmigrated.erase(key))
+                continue;
+            admit(key);
+            unsigned hits = std::min(history.accesses(key), 4u);
+            for (unsigned i = 1; i < hits; i++)
+            {
+                update(key);
+            }
+            fed++;
+        }
+    }
+
+    // Change the capacity in place, without flushing. A larger capacity
+    // applies at once. A smaller one only lowers the limit: put() keeps
+    // evicting one entry per insert, and trim() works off the surplus in
+    // small batches, so no single request pays for the whole difference.
+    void resize(int new_capacity)
+    {
+        int previous = capacity;
+        capacity = std::max(1, new_capacity);
+        if (capacity != previous)
+            resized(previous);
+    }
+
+    // Scale policy-internal segment sizes to the new capacity.
+    virtual void resized(int) {}
+
+    // How full the cache is, as a fraction of its capacity.
+    virtual double fill() const { return double(cache.size()) / capacity; }
+
+    bool above_high_watermark() const { return fill() > high_watermark; }
+
+    // Evict up to batch entries while the fill level is above target.
+    // Returns true if it is still above target afterwards and the policy
+    // can evict more.
+    bool trim(int batch, double target = 1.0)
+    {
+        for (; batch > 0 && fill() > target; batch--)
+        {
+            size_t before = cache.size();
+            evict();
+            if (cache.size() == before && !drop_unmigrated())
+                return false;
+            background_evictions++;
+        }
+        return fill() > target;
+    }
+
+    // Evict the coldest adopted entry the policy does not know yet, for when
+    // the policy itself has nothing to evict.
+    bool drop_unmigrated()
+    {
+        while (!migration_order.empty())
+        {
+            std::string key = migration_order.front();
+            migration_order.pop_front();
+            if (unmigrated.erase(key))
+            {
+                erase_entry(key);
+                forget(key);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Decide whether a new entry is worth a slot, learning from it either way.
+    bool should_admit(const std::string &query, const CacheEntry &entry)
+    {
+        history.record_access(query);
+        history.record_cost(query, entry.cost_ms);
+        double value = history.accesses(query) * history.cost(query) / (query.size() + entry.size_bytes());
+        bool admit = cache.size() < (size_t)capacity || average_value == 0 || value >= admission_ratio * average_value;
+        average_value = average_value == 0 ? value : 0.9 * average_value + 0.1 * value;
+        return admit;
+    }
+
+    virtual std::string get(const std::string &query, unsigned long snapshot = latest_snapshot)
+    {
+        catch_up();
+        auto it = cache.find(query);
+        if (it != cache.end() && it->second.visible(snapshot))
+        {
+            record_hit(query);
+            return it->second.result;
+        }
+        else
+        {
+            cache_misses++;
+            return "";
+        }
+    }
+
+    virtual void put(const std::string &query, CacheEntry entry)
+    {
+        catch_up();
+        auto it = cache.find(query);
+        if (it != cache.end())
+        {
+            // A version that is still current is kept; an ended one is replaced.
+            if (it->second.valid_to == ULONG_MAX)
+            {
+                touch(query);
+                return;
+            }
+            erase_entry(query);
+            forget(query);
+        }
+        if (!should_admit(query, entry) || !accept(query, entry))
+        {
+            entries_rejected++;
+            return;
+        }
+        if (!entry.reuse_group.empty())
+            absorb_subsumed(entry);
+        if (cache.size() >= (size_t)capacity)
+        {
+            inline_evictions++;
+            evict();
+            if (cache.size() >= (size_t)capacity)
+                drop_unmigrated();
+        }
+        for (const auto &table : entry.tables)
+        {
+            table_index[table].insert(query);
+        }
+        if (!entry.reuse_group.empty())
+            reuse_index[entry.reuse_group].emplace(entry.range.low, query);
+        entry.last_used = ++access_clock;
+        cache[query] = std::move(entry);
+        admit(query);
+    }
+
+    // Find a visible entry in group whose rows can answer a read of columns
+    // over range, preferring the exact query. Counts as a hit or a miss like
+    // get(). The pointer is valid until the cache is next modified.
+    const CacheEntry *get_reusable(const std::string &query, const std::string &group, const Interval &range,
+                                   const std::string &filter_column, const std::vector<std::string> &columns, unsigned long snapshot)
+    {
+        catch_up();
+        auto exact = cache.find(query);
+        std::string found;
+        if (exact != cache.end() && exact->second.visible(snapshot))
+        {
+            found = query;
+        }
+        else
+        {
+            auto indexed = reuse_index.find(group);
+            if (indexed != reuse_index.end())
+            {
+                // Only entries starting at or below the requested low bound can cover it.
+                for (auto it = indexed->second.begin(); it != indexed->second.end() && it->first <= range.low; ++it)
+                {
+                    const CacheEntry &candidate = cache[it->second];
+                    if (candidate.visible(snapshot) && candidate.can_answer(range, columns, filter_column))
+                    {
+                        found = it->second;
+                        break;
+                    }
+                }
+            }
+        }
+        if (found.empty())
+        {
+            cache_misses++;
+            return nullptr;
+        }
+        record_hit(found);
+        if (found != query)
+            subsumed_hits++;
+        return &cache[found];
+    }
+
+    // Find the cached row prefix of a paginated query if it reaches row end.
+    // Counts as a hit or a miss like get().
+    const CacheEntry *get_prefix(const std::string &prefix_key, size_t end, unsigned long snapshot)
+    {
+        catch_up();
+        const CacheEntry *entry = peek(prefix_key, snapshot);
+        if (entry && entry->rows && (entry->rows->rows.size() >= end || entry->prefix_complete))
+        {
+            record_hit(prefix_key);
+            return entry;
+        }
+        cache_misses++;
+        return nullptr;
+    }
+
+    // Like get(), for entries that hold rows rather than rendered text.
+    std::shared_ptr<const ResultSet> get_rows(const std::string &query, unsigned long snapshot)
+    {
+        catch_up();
+        const CacheEntry *entry = peek(query, snapshot);
+        if (!entry || !entry->rows)
+        {
+            cache_misses++;
+            return nullptr;
+        }
+        record_hit(query);
+        return entry->rows;
+    }
+
+    // Find a visible entry without counting or touching it.
+    const CacheEntry *peek(const std::string &query, unsigned long snapshot) const
+    {
+        auto it = cache.find(query);
+        return it != cache.end() && it->second.visible(snapshot) ? &it->second : nullptr;
+    }
+
+    void put(const std::string &query, const std::string &result)
+    {
+        CacheEntry entry;
+        entry.result = result;
+        put(query, std::move(entry));
+    }
+
+    // Close the validity interval of every entry computed from a written
+    // table at the commit that wrote it, in one pass for a whole commit group.
+    // Entries that no open snapshot can see are dropped.
+    void end_versions(const std::map<std::string, unsigned long> &written, unsigned long oldest_snapshot)
+    {
+        std::unordered_map<std::string, unsigned long> ends;
+        for (const auto &table : written)
+        {
+            auto it = table_index.find(table.first);
+            if (it == table_index.end())
+                continue;
+            for (const auto &key : it->second)
+            {
+                auto end = ends.emplace(key, table.second).first;
+                end->second = std::min(end->second, table.second);
+            }
+        }
+        for (const auto &end : ends)
+        {
+            const std::string &key = end.first;
+            CacheEntry &entry = cache[key];
+            entry.valid_to = std::min(entry.valid_to, end.second);
+            if (oldest_snapshot >= entry.valid_to)
+            {
+                erase_entry(key);
+                forget(key);
+            }
+        }
+    }
+
+    // A current entry makes current entries of its group that it can answer
+    // redundant, so admitting it frees their slots.
+    void absorb_subsumed(const CacheEntry &wider)
+    {
+        auto indexed = reuse_index.find(wider.reuse_group);
+        if (indexed == reuse_index.end() || wider.valid_to != ULONG_MAX)
+            return;
+        std::string filter_column = wider.reuse_group.substr(wider.reuse_group.rfind('|') + 1);
+        std::vector<std::string> covered;
+        for (const auto &bound : indexed->second)
+        {
+            const CacheEntry &narrower = cache[bound.second];
+            std::vector<std::string> columns;
+            if (!narrower.all_columns)
+                columns = narrower.rows->columns;
+            if (narrower.valid_to == ULONG_MAX && wider.can_answer(narrower.range, columns, filter_column))
+                covered.push_back(bound.second);
+        }
+        for (const auto &key : covered)
+        {
+            erase_entry(key);
+            forget(key);
+            entries_absorbed++;
+        }
+    }
+
+    // Remove a key from the index once the policy has let go of it.
+    void erase_entry(const std::string &query)
+    {
+        auto it = cache.find(query);
+        if (it == cache.end())
+            return;
+        unmigrated.erase(query);
+        if (!it->second.reuse_group.empty())
+        {
+            auto &group = reuse_index[it->second.reuse_group];
+            for (auto bound = group.begin(); bound != group.end(); ++bound)
+            {
+                if (bound->second == query)
+                {
+                    group.erase(bound);
+                    break;
+                }
+            }
+            if (group.empty())
+                reuse_index.erase(it->second.reuse_group);
+        }
+        for (const auto &table : it->second.tables)
+        {
+            auto indexed = table_index.find(table);
+            if (indexed == table_index.end())
+                continue;
+            indexed->second.erase(query);
+            if (indexed->second.empty())
+                table_index.erase(indexed);
+        }
+        cache.erase(it);
+    }
+
+    // Visit up to count entries drawn from random buckets of the index.
+    template <class Visit>
+    void sample_entries(std::mt19937 &rng, int count, Visit visit)
+    {
+        cache.sample(rng, count, visit);
+    }
+
+    // True if update() only sets per-entry bits that concurrent callers may
+    // write at once, so a hit needs a shared lock rather than the exclusive
+    // one that admission and eviction take.
+    virtual bool shared_hits() const { return false; }
+
+    // Policy-specific admission check, run after the cost-based one.
+    virtual bool accept(const std::string &, const CacheEntry &) { return true; }
+    virtual void admit(const std::string &query) = 0;
+    virtual void update(const std::string &query) = 0;
+    virtual void evict() = 0;
+    // Drop a key from the policy's own structures without evicting anything.
+    virtual void forget(const std::string &query) = 0;
+
+    virtual void stats()
+    {
+        apply_shared_hits();
+        std::cout << "Cache Hits: " << cache_hits << "\n";
+        std::cout << "Cache Misses: " << cache_misses << "\n";
+        std::cout << "Execution Time Saved: " << saved_ms << " ms\n";
+        std::cout << "Admission Rejections: " << entries_rejected << "\n";
+        std::cout << "Evictions: " << background_evictions << " in the background, " << inline_evictions << " inline\n";
+        std::cout << "Subsumption Hits: " << subsumed_hits << " (subsumed entries absorbed: " << entries_absorbed << ")\n";
+        std::cout << "Current Cache Size: " << cache.size() << " (index grown " << cache.growths << " times)\n";
+        if (!unmigrated.empty())
+            std::cout << "Entries Still Migrating: " << unmigrated.size() << "\n";
+        std::cout << "Cached Queries:\n";
+        for (const auto &entry : cache)
+        {
+            std::cout << " - " << entry.first;
+            if (entry.second.valid_to != ULONG_MAX)
+                std::cout << " (superseded at " << entry.second.valid_to << ")";
+            std::cout << "\n";
+        }
+    }
+};
+
+// LIRS Cache Implementation (Low Inter-reference Recency)
+
+class LIRSCache : public CacheStrategy
+{
+    std::deque<std::string> high_interference_list; // High reuse queries
+    std::deque<std::string> low_interference_list;  // Low reuse queries
+    std::unordered_map<std::string, bool> in_high;
+
+public:
+    LIRSCache(int cap) : CacheStrategy(cap) {}
+
+    void admit(const std::string &query) override
+    {
+        high_interference_list.push_back(query);
+        in_high[query] = true;
+    }
+
+    void update(const std::string &query) override
+    {
+        if (in_high[query])
+        {
+            // Move to front to make it the most recently used in high-interference list.
+            high_interference_list.erase(std::remove(high_interference_list.begin(), high_interference_list.end(), query), high_interference_list.end());
+            high_interference_list.push_back(query);
+        }
+        else
+        {
+            // Promote to high-interference list.
+            low_interference_list.erase(std::remove(low_interference_list.begin(), low_interference_list.end(), query), low_interference_list.end());
+            high_interference_list.push_back(query);
+            in_high[query] = true;
+        }
+    }
+
+    void evict() override
+    {
+        std::string victim;
+        if (!high_interference_list.empty())
+        {
+            victim = high_interference_list.front();
+            high_interference_list.pop_front();
+        }
+        else if (!low_interference_list.empty())
+        {
+            victim = low_interference_list.front();
+            low_interference_list.pop_front();
+        }
+        else if (!cache.empty())
+        {
+            victim = cache.begin()->first;
+        }
+        if (!victim.empty())
+        {
+            erase_entry(victim);
+            in_high.erase(victim);
+            if (verbose)
+                std::cout << "LIRS Evicted: " << victim << "\n";
+        }
+    }
+
+    void forget(const std::string &query) override
+    {
+        high_interference_list.erase(std::remove(high_interference_list.begin(), high_interference_list.end(), query), high_interference_list.end());
+        low_interference_list.erase(std::remove(low_interference_list.begin(), low_interference_list.end(), query), low_interference_list.end());
+        in_high.erase(query);
+    }
+};
+
+// TinyFLU Cache Implementation (Tiny First Look Up)
+
+class TinyFLUCache : public CacheStrategy
+{
+    std::deque<std::string> query_queue;
+
+public:
+    TinyFLUCache(int cap) : CacheStrategy(cap) {}
+
+    void admit(const std::string &query) override
+    {
+        query_queue.push_back(query);
+    }
+
+    void update(const std::string &query) override
+    {
+        // Move query to the end of the deque, indicating it was recently used.
+        query_queue.erase(std::remove(query_queue.begin(), query_queue.end(), query), query_queue.end());
+        query_queue.push_back(query);
+    }
+
+    void evict() override
+    {
+        if (!query_queue.empty())
+        {
+            std::string victim = query_queue.front();
+            query_queue.pop_front();
+            erase_entry(victim);
+            if (verbose)
+                std::cout << "TinyFLU Evicted: " << victim << "\n";
+        }
+    }
+
+    void forget(const std::string &query) override
+    {
+        query_queue.erase(std::remove(query_queue.begin(), query_queue.end(), query), query_queue.end());
+    }
+};
+
+/// S3-FIFO Cache Implementation
+class S3FIFOCache : public CacheStrategy
+{
+    std::deque<std::string> short_term;
+    std::deque<std::string> medium_term;
+    std::deque<std::string> long_term;
+
+public:
+    S3FIFOCache(int cap) : CacheStrategy(cap) {}
+
+    void admit(const std::string &query) override
+    {
+        // New queries go to short-term queue.
+        short_term.push_back(query);
+    }
+
+    void update(const std::string &query) override
+    {
+        // Promote queries across queues.
+        auto it = std::find(short_term.begin(), short_term.end(), query);
+        if (it != short_term.end())
+        {
+            short_term.erase(it);
+            medium_term.push_back(query);
+            return;
+        }
+        it = std::find(medium_term.begin(), medium_term.end(), query);
+        if (it != medium_term.end())
+        {
+            medium_term.erase(it);
+            long_term.push_back(query);
+            return;
+        }
+        it = std::find(long_term.begin(), long_term.end(), query);
+        if (it != long_term.end())
+        {
+            long_term.erase(it);
+            long_term.push_back(query); // Refresh position.
+        }
+    }
+
+    void evict() override
+    {
+        std::string victim;
+        if (!short_term.empty())
+        {
+            victim = short_term.front();
+            short_term.pop_front();
+        }
+        else if (!medium_term.empty())
+        {
+            victim = medium_term.front();
+            medium_term.pop_front();
+        }
+        else if (!long_term.empty())
+        {
+            victim = long_term.front();
+            long_term.pop_front();
+        }
+        else if (!cache.empty())
+        {
+            victim = cache.begin()->first;
+        }
+        if (!victim.empty())
+        {
+            erase_entry(victim);
+            if (verbose)
+                std::cout << "S3-FIFO Evicted: " << victim << "\n";
+        }
+    }
+
+    void forget(const std::string &query) override
+    {
+        for (auto *queue : {&short_term, &medium_term, &long_term})
+        {
+            queue->erase(std::remove(queue->begin(), queue->end(), query), queue->end());
+        }
+    }
+};
+
+// GDSF Cache Implementation (GreedyDual-Size-Frequency)
+//
+// Ranks entries by H = L + frequency * cost / size, where cost is the EWMA of
+// the query's measured execution time and L is an inflation clock set to the
+// H of the last victim, so entries that stop being hit age out. Evicts the
+// lowest H from an ordered set in O(log n), maximizing execution time saved
+// per cached byte rather than raw hit ratio.
+class GDSFCache : public CacheStrategy
+{
+    struct Rank
+    {
+        double priority;
+        unsigned long frequency;
+    };
+
+    std::set<std::pair<double, std::string>> queue; // (H, query), lowest first
+    std::unordered_map<std::string, Rank> ranks;
+    std::unordered_map<std::string, double> cost_ewma; // Outlives entries so re-admissions keep their history.
+    std::deque<std::string> cost_order;                // Bounds cost_ewma in FIFO order.
+    double inflation;
+
+    double priority(const std::string &query, unsigned long frequency)
+    {
+        size_t size = query.size() + cache[query].size_bytes();
+        return inflation + frequency * cost_ewma[query] / size;
+    }
+
+    void reprioritize(const std::string &query, unsigned long frequency)
+    {
+        auto it = ranks.find(query);
+        if (it != ranks.end())
+            queue.erase({it->second.priority, query});
+        Rank rank{priority(query, frequency), frequency};
+        ranks[query] = rank;
+        queue.insert({rank.priority, query});
+    }
+
+public:
+    GDSFCache(int cap) : CacheStrategy(cap), inflation(0) {}
+
+    void admit(const std::string &query) override
+    {
+        // Fold the measured cost into the per-fingerprint EWMA.
+        double cost = cache[query].cost_ms;
+        auto known = cost_ewma.find(query);
+        if (known == cost_ewma.end())
+        {
+            cost_ewma[query] = cost;
+            cost_order.push_back(query);
+            if (cost_order.size() > (size_t)capacity * 8)
+            {
+                cost_ewma.erase(cost_order.front());
+                cost_order.pop_front();
+            }
+        }
+        else
+        {
+            known->second = 0.7 * known->second + 0.3 * cost;
+        }
+        reprioritize(query, 1);
+    }
+
+    void update(const std::string &query) override
+    {
+        auto it = ranks.find(query);
+        reprioritize(query, it == ranks.end() ? 1 : it->second.frequency + 1);
+    }
+
+    void evict() override
+    {
+        if (queue.empty())
+            return;
+        auto victim = *queue.begin();
+        queue.erase(queue.begin());
+        ranks.erase(victim.second);
+        inflation = victim.first;
+        erase_entry(victim.second);
+        if (verbose)
+            std::cout << "GDSF Evicted: " << victim.second << "\n";
+    }
+
+    void forget(const std::string &query) override
+    {
+        auto it = ranks.find(query);
+        if (it == ranks.end())
+            return;
+        queue.erase({it->second.priority, query});
+        ranks.erase(it);
+    }
+};
+
+// ARC Cache Implementation (Adaptive Replacement Cache)
+//
+// T1 holds entries seen once recently and T2 entries seen at least twice;
+// B1 and B2 remember what was recently evicted from each. A miss that hits
+// B1 means T1 was too small, one that hits B2 means T2 was, and the target
+// size p of T1 moves accordingly, so the cache follows the workload between
+// recency- and frequency-heavy phases. All four lists are intrusive doubly
+// linked lists through nodes held in hash maps, so every operation is O(1),
+// and ghost nodes keep only the query's fingerprint hash.
+class ARCCache : public CacheStrategy
+{
+    struct Node
+    {
+        Node *prev = nullptr;
+        Node *next = nullptr;
+        int list = -1;
+        const std::string *query = nullptr; // Resident nodes only.
+        size_t fingerprint = 0;
+    };
+
+    struct List
+    {
+        Node head; // Sentinel: head.next is the LRU end, head.prev the MRU end.
+        size_t size = 0;
+
+        List() { head.prev = head.next = &head; }
+        List(const List &) = delete;
+
+        void push_back(Node *node)
+        {
+            node->prev = head.prev;
+            node->next = &head;
+            head.prev->next = node;
+            head.prev = node;
+            size++;
+        }
+        void remove(Node *node)
+        {
+            node->prev->next = node->next;
+            node->next->prev = node->prev;
+            node->prev = node->next = nullptr;
+            size--;
+        }
+        Node *front() { return size ? head.next : nullptr; }
+    };
+
+    enum
+    {
+        T1,
+        T2,
+        B1,
+        B2
+    };
+
+    List lists[4];
+    std::unordered_map<std::string, Node> resident;
+    std::unordered_map<size_t, Node> ghosts;
+    size_t target;      // p: the desired size of T1.
+    bool replacing_b2; // The pending admission was found in B2.
+
+    void move_to(Node *node, int list)
+    {
+        if (node->list >= 0)
+            lists[node->list].remove(node);
+        node->list = list;
+        lists[list].push_back(node);
+    }
+
+    void drop_ghost(int list)
+    {
+        Node *ghost = lists[list].front();
+        if (!ghost)
+            return;
+        lists[list].remove(ghost);
+        ghosts.erase(ghost->fingerprint);
+    }
+
+public:
+    ARCCache(int cap) : CacheStrategy(cap), target(0), replacing_b2(false) {}
+
+    // Runs before any eviction for the new entry: adapt p on a ghost hit.
+    bool accept(const std::string &query, const CacheEntry &) override
+    {
+        auto ghost = ghosts.find(std::hash<std::string>{}(query));
+        replacing_b2 = false;
+        if (ghost == ghosts.end())
+            return true;
+        size_t b1 = lists[B1].size, b2 = lists[B2].size;
+        if (ghost->second.list == B1)
+        {
+            target = std::min<size_t>(capacity, target + std::max<size_t>(1, b2 / b1));
+        }
+        else
+        {
+            target -= std::min(target, std::max<size_t>(1, b1 / b2));
+            replacing_b2 = true;
+        }
+        return true;
+    }
+
+    void admit(const std::string &query) override
+    {
+        size_t fingerprint = std::hash<std::string>{}(query);
+        auto inserted = resident.emplace(query, Node()).first;
+        Node *node = &inserted->second;
+        node->query = &inserted->first;
+        node->fingerprint = fingerprint;
+
+        auto ghost = ghosts.find(fingerprint);
+        if (ghost != ghosts.end())
+        {
+            // Seen before and evicted: it goes straight to the frequency side.
+            lists[ghost->second.list].remove(&ghost->second);
+            ghosts.erase(ghost);
+            move_to(node, T2);
+        }
+        else
+        {
+            move_to(node, T1);
+        }
+
+        // Keep T1 + B1 within c and the whole directory within 2c.
+        if (lists[T1].size + lists[B1].size > (size_t)capacity)
+            drop_ghost(B1);
+        while (resident.size() + ghosts.size() > 2 * (size_t)capacity && (lists[B2].size || lists[B1].size))
+        {
+            drop_ghost(lists[B2].size ? B2 : B1);
+        }
+    }
+
+    void update(const std::string &query) override
+    {
+        auto it = resident.find(query);
+        if (it != resident.end())
+            move_to(&it->second, T2);
+    }
+
+    void evict() override
+    {
+        size_t t1 = lists[T1].size;
+        bool from_t1 = t1 && (t1 > target || (replacing_b2 && t1 == target) || !lists[T2].size);
+        Node *victim = lists[from_t1 ? T1 : T2].front();
+        if (!victim)
+            return;
+        std::string query = *victim->query;
+        Node &ghost = ghosts[victim->fingerprint];
+        if (ghost.list >= 0)
+            lists[ghost.list].remove(&ghost);
+        ghost.fingerprint = victim->fingerprint;
+        move_to(&ghost, from_t1 ? B1 : B2);
+        lists[victim->list].remove(victim);
+        resident.erase(query);
+        erase_entry(query);
+        if (verbose)
+            std::cout << "ARC Evicted: " << query << "\n";
+    }
+
+    void forget(const std::string &query) override
+    {
+        auto it = resident.find(query);
+        if (it == resident.end())
+            return;
+        lists[it->second.list].remove(&it->second);
+        resident.erase(it);
+    }
+
+    // Keep T1's target share of the cache; the ghost lists trim themselves
+    // to the new bound on the next admissions.
+    void resized(int previous) override
+    {
+        target = std::min<size_t>(capacity, target * capacity / previous);
+    }
+};
+
+// CLOCK and SIEVE Cache Implementations
+//
+// Entries sit on a ring swept by a single hand. A hit only sets the entry's
+// visited bit; the hand clears set bits as it passes and evicts the first
+// entry it finds unvisited. CLOCK places a new entry just behind the hand,
+// so it is the last one the hand reaches. SIEVE appends new entries at the
+// newest end and leaves survivors where they are, so one-hit entries near
+// the hand go quickly while proven ones stay put.
+class CLOCKCache : public CacheStrategy
+{
+    struct Node
+    {
+        std::string query;
+        std::atomic<bool> visited;
+
+        explicit Node(const std::string &q) : query(q), visited(false) {}
+    };
+
+    std::list<Node> ring; // Oldest at the front; the hand sweeps front to back.
+    std::unordered_map<std::string, std::list<Node>::iterator> nodes;
+    std::list<Node>::iterator hand; // ring.end() wraps to the front.
+    bool sieve;
+
+public:
+    CLOCKCache(int cap, bool sieve_insertion = false) : CacheStrategy(cap), hand(ring.end()), sieve(sieve_insertion) {}
+
+    bool shared_hits() const override { return true; }
+
+    void admit(const std::string &query) override
+    {
+        nodes[query] = ring.emplace(sieve ? ring.end() : hand, query);
+    }
+
+    void update(const std::string &query) override
+    {
+        auto it = nodes.find(query);
+        if (it != nodes.end())
+            it->second->visited.store(true, std::memory_order_relaxed);
+    }
+
+    void evict() override
+    {
+        if (ring.empty())
+            return;
+        if (hand == ring.end())
+            hand = ring.begin();
+        while (hand->visited.exchange(false, std::memory_order_relaxed))
+        {
+            if (++hand == ring.end())
+                hand = ring.begin();
+        }
+        std::string victim = hand->query;
+        nodes.erase(victim);
+        hand = ring.erase(hand);
+        erase_entry(victim);
+        if (verbose)
+            std::cout << (sieve ? "SIEVE" : "CLOCK") << " Evicted: " << victim << "\n";
+    }
+
+    void forget(const std::string &query) override
+    {
+        auto it = nodes.find(query);
+        if (it == nodes.end())
+            return;
+        if (hand == it->second)
+            ++hand;
+        ring.erase(it->second);
+        nodes.erase(it);
+    }
+};
+
+// CLOCK-Pro Cache Implementation
+//
+// One ring holds hot and cold resident entries plus non-resident cold
+// entries still in their test period. Three hands sweep it: the cold hand
+// evicts unreferenced cold entries (which stay on the ring as test entries)
+// and promotes referenced ones to hot; the hot hand demotes unreferenced hot
+// entries to cold whenever hot entries exceed their share; the test hand
+// ends test periods. A test entry re-requested before its period ends grows
+// the cold share, one that expires shrinks it. Hits only set the reference
+// bit, exactly as in CLOCK.
+class CLOCKProCache : public CacheStrategy
+{
+    enum Kind
+    {
+        Hot,
+        Cold,
+        Test
+    };
+
+    struct Node
+    {
+        std::string query;
+        Kind kind;
+        std::atomic<bool> referenced;
+
+        Node(const std::string &q, Kind k) : query(q), kind(k), referenced(false) {}
+    };
+
+    typedef std::list<Node>::iterator Position;
+
+    std::list<Node> ring; // New entries go just behind the hot hand.
+    std::unordered_map<std::string, Position> nodes;
+    Position hand_hot, hand_cold, hand_test;
+    size_t hot_count, cold_count, test_count;
+    size_t cold_target; // Adaptive number of resident slots for cold entries.
+
+    Position next(Position it)
+    {
+        return ++it == ring.end() ? ring.begin() : it;
+    }
+
+    void unlink(Position it)
+    {
+        for (Position *hand : {&hand_hot, &hand_cold, &hand_test})
+        {
+            if (*hand == it)
+                *hand = next(it);
+        }
+        nodes.erase(it->query);
+        ring.erase(it);
+        if (ring.empty())
+            hand_hot = hand_cold = hand_test = ring.end();
+    }
+
+    void insert(const std::string &query, Kind kind)
+    {
+        Position it = ring.emplace(hand_hot, query, kind);
+        if (ring.size() == 1)
+            hand_hot = hand_cold = hand_test = it;
+        nodes[query] = it;
+        (kind == Hot ? hot_count : cold_count)++;
+    }
+
+    // A test entry whose period ended without a re-request: drop it, and
+    // since cold entries are not earning their keep, shrink their share.
+    void expire_test(Position it)
+    {
+        unlink(it);
+        test_count--;
+        if (cold_target > 1)
+            cold_target--;
+    }
+
+    void run_hand_test()
+    {
+        Position it = hand_test;
+        hand_test = next(hand_test);
+        if (it->kind == Test)
+            expire_test(it);
+    }
+
+    void run_hand_hot()
+    {
+        Position it = hand_hot;
+        hand_hot = next(hand_hot);
+        if (it->kind == Test)
+        {
+            expire_test(it);
+        }
+        else if (it->kind == Hot && !it->referenced.exchange(false, std::memory_order_relaxed))
+        {
+            it->kind = Cold;
+            hot_count--;
+            cold_count++;
+        }
+    }
+
+    // Advance the cold hand one entry. Returns the query it evicted, if any.
+    std::string run_hand_cold()
+    {
+        Position it = hand_cold;
+        hand_cold = next(hand_cold);
+        std::string victim;
+        if (it->kind == Cold)
+        {
+            cold_count--;
+            if (it->referenced.exchange(false, std::memory_order_relaxed))
+            {
+                it->kind = Hot;
+                hot_count++;
+            }
+            else
+            {
+                it->kind = Test;
+                test_count++;
+                victim = it->query;
+                while (test_count > (size_t)capacity)
+                    run_hand_test();
+            }
+        }
+        while (hot_count > 0 && hot_count > (size_t)capacity - std::min<size_t>(capacity, cold_target))
+            run_hand_hot();
+        return victim;
+    }
+
+public:
+    CLOCKProCache(int cap) : CacheStrategy(cap), hand_hot(ring.end()), hand_cold(ring.end()), hand_test(ring.end()),
+                             hot_count(0), cold_count(0), test_count(0), cold_target(std::max(cap, 1)) {}
+
+    bool shared_hits() const override { return true; }
+
+    void admit(const std::string &query) override
+    {
+        auto it = nodes.find(query);
+        if (it == nodes.end())
+        {
+            insert(query, Cold);
+            return;
+        }
+        // Re-requested within its test period: its reuse distance beats
+        // that of the hot entries, so it comes back hot.
+        unlink(it->second);
+        test_count--;
+        cold_target = std::min<size_t>(capacity, cold_target + 1);
+        insert(query, Hot);
+    }
+
+    void update(const std::string &query) override
+    {
+        auto it = nodes.find(query);
+        if (it != nodes.end() && it->second->kind != Test)
+            it->second->referenced.store(true, std::memory_order_relaxed);
+    }
+
+    void evict() override
+    {
+        // Every lap clears reference bits, so this ends within a few laps.
+        for (size_t steps = 0; hot_count + cold_count > 0 && steps < 4 * ring.size(); steps++)
+        {
+            std::string victim = run_hand_cold();
+            if (victim.empty())
+                continue;
+            erase_entry(victim);
+            if (verbose)
+                std::cout << "CLOCK-Pro Evicted: " << victim << "\n";
+            return;
+        }
+    }
+
+    void forget(const std::string &query) override
+    {
+        auto it = nodes.find(query);
+        if (it == nodes.end())
+            return;
+        Kind kind = it->second->kind;
+        (kind == Hot ? hot_count : kind == Cold ? cold_count : test_count)--;
+        unlink(it->second);
+    }
+
+    // Keep the cold share of the resident slots.
+    void resized(int previous) override
+    {
+        cold_target = std::max<size_t>(1, std::min<size_t>(capacity, cold_target * capacity / previous));
+    }
+};
+
+// Sampled Cache Implementation (Redis-style approximate LRU/LFU)
+//
+// No list or heap orders the entries. Each keeps its policy state in the 32
+// bits of CacheEntry::access_bits: a 24-bit logical access clock for LRU, or
+// for LFU a 16-bit decay period stamp above an 8-bit logarithmic counter.
+// Eviction samples a few random buckets of the index, merges the entries
+// found into a small pool of the best candidates seen so far, and evicts the
+// best pooled entry still cached, so good candidates carry over between
+// evictions.
+class SampledCache : public CacheStrategy
+{
+    static const size_t pool_size = 16;
+    static const uint32_t clock_mask = (1u << 24) - 1;
+    static const uint32_t initial_count = 5; // New LFU entries start here so they are not evicted at once.
+
+    struct Candidate
+    {
+        uint32_t idle; // Higher is a better victim.
+        std::string query;
+    };
+
+    std::vector<Candidate> pool; // Ascending idle; the best victim is at the back.
+    std::mt19937 rng;
+    uint32_t clock;
+    bool lfu;
+
+    uint32_t period() const { return (clock >> 10) & 0xFFFF; }
+
+    // The LFU counter after decaying by one per period since its stamp.
+    uint32_t decayed_count(uint32_t bits) const
+    {
+        uint32_t elapsed = (period() - (bits >> 8)) & 0xFFFF;
+        uint32_t count = bits & 0xFF;
+        return elapsed >= count ? 0 : count - elapsed;
+    }
+
+    uint32_t idle(uint32_t bits) const
+    {
+        return lfu ? 255 - decayed_count(bits) : (clock - bits) & clock_mask;
+    }
+
+    void touch(CacheEntry &entry, bool fresh)
+    {
+        clock = (clock + 1) & clock_mask;
+        if (!lfu)
+        {
+            entry.access_bits = clock;
+            return;
+        }
+        uint32_t count = fresh ? initial_count : decayed_count(entry.access_bits);
+        // Logarithmic increment: the higher the count, the less likely a bump.
+        double base = count > initial_count ? count - initial_count : 0;
+        if (!fresh && count < 255 && std::uniform_real_distribution<double>(0, 1)(rng) < 1.0 / (base * log_factor + 1))
+            count++;
+        entry.access_bits = period() << 8 | count;
+    }
+
+    // Sample entries from random buckets into the pool, keeping the best.
+    void populate_pool()
+    {
+        sample_entries(rng, samples, [this](const std::string &query, const CacheEntry &entry)
+                       {
+            uint32_t score = idle(entry.access_bits);
+            if (pool.size() == pool_size && score <= pool.front().idle)
+                return;
+            auto known = std::find_if(pool.begin(), pool.end(), [&query](const Candidate &candidate)
+                                      { return candidate.query == query; });
+            if (known != pool.end())
+                pool.erase(known);
+            else if (pool.size() == pool_size)
+                pool.erase(pool.begin());
+            Candidate candidate{score, query};
+            pool.insert(std::upper_bound(pool.begin(), pool.end(), candidate, [](const Candidate &a, const Candidate &b)
+                                         { return a.idle < b.idle; }),
+                        candidate); });
+    }
+
+public:
+    int samples = 5;     // Entries sampled per eviction.
+    int log_factor = 10; // LFU counter growth: about 1M hits saturate it at 10.
+
+    SampledCache(int cap, bool least_frequent = false) : CacheStrategy(cap), rng(42), clock(0), lfu(least_frequent)
+    {
+        pool.reserve(pool_size);
+    }
+
+    void admit(const std::string &query) override
+    {
+        touch(cache[query], true);
+    }
+
+    void update(const std::string &query) override
+    {
+        auto it = cache.find(query);
+        if (it != cache.end())
+            touch(it->second, false);
+    }
+
+    void evict() override
+    {
+        while (!cache.empty())
+        {
+            populate_pool();
+            // Pooled scores may be stale; entries since removed are skipped.
+            while (!pool.empty())
+            {
+                std::string victim = pool.back().query;
+                pool.pop_back();
+                if (!cache.count(victim))
+                    continue;
+                erase_entry(victim);
+                if (verbose)
+                    std::cout << (lfu ? "Sampled-LFU" : "Sampled-LRU") << " Evicted: " << victim << "\n";
+                return;
+            }
+        }
+    }
+
+    void forget(const std::string &) override {}
+};
+
+// Learned Cache Implementation (learned relaxed Belady)
+//
+// Belady's OPT evicts the entry requested furthest in the future. A small
+// logistic model instead estimates, from an entry's features, whether it
+// will be requested within a boundary of boundary_factor * capacity
+// requests, and eviction picks the sampled candidate least likely to be.
+// Features are the age since the last request, the last three inter-arrival
+// gaps, the request count, the size, the execution cost and whether the key
+// is a plain SELECT. All but the age are refreshed on each request and kept
+// in the policy's own index of resident entries, which eviction samples
+// directly, so scoring a candidate is one log and a dot product. Labels come
+// from the real request stream: a few candidates of every eviction are
+// remembered with their features, labeled positive if requested again within
+// the boundary and negative once they fall out of that window. A background
+// thread runs SGD over the labeled samples and publishes new weights;
+// eviction only reads them.
+class LearnedCache : public CacheStrategy
+{
+    static const int feature_count = 8;
+    typedef std::array<float, feature_count> Features;
+    typedef std::array<float, feature_count + 1> Weights; // The bias is last.
+
+    struct History
+    {
+        uint32_t last = 0;
+        uint32_t gaps[3] = {}; // Most recent first; 0 while unknown.
+        uint32_t count = 0;
+        Features features = {}; // Everything but the age, as of the last request.
+    };
+
+    struct Sample
+    {
+        uint32_t time;
+        std::string query;
+        Features features;
+        bool labeled;
+    };
+
+    struct Labeled
+    {
+        Features features;
+        float label;
+    };
+
+    std::unordered_map<std::string, History> resident;
+    std::unordered_map<std::string, History> past; // Evicted entries, bounded in FIFO order.
+    std::deque<std::pair<std::string, uint32_t>> past_order; // (query, last request) as retired
+    std::deque<Sample> window;                            // Unlabeled samples in request order.
+    std::unordered_map<std::string, uint32_t> sampled_at; // query -> time of its newest sample
+    std::mt19937 rng;
+    uint32_t now;
+
+    Weights weights; // Latest weights published by the trainer.
+    std::mutex model_mutex;
+
+    std::vector<Labeled> queued; // Labeled samples waiting for the trainer.
+    std::mutex train_mutex;
+    std::condition_variable train_ready;
+    bool stopping;
+    std::atomic<long> trained;
+    std::thread trainer;
+
+    long evictions;
+    double evict_ns;
+
+    static float scaled_log(double value) { return std::log2(1 + (float)value) / 16; }
+
+    uint32_t boundary() const { return (uint32_t)(boundary_factor * capacity); }
+
+    // Logit of the reuse probability; eviction compares these directly.
+    static float margin(const Weights &w, const Features &x)
+    {
+        float z = w[feature_count];
+        for (int i = 0; i < feature_count; i++)
+        {
+            z += w[i] * x[i];
+        }
+        return z;
+    }
+
+    void emit(const Features &x, bool reused)
+    {
+        std::lock_guard<std::mutex> guard(train_mutex);
+        queued.push_back({x, reused ? 1.0f : 0.0f});
+        if (queued.size() >= 64)
+            train_ready.notify_one();
+    }
+
+    // Record a request: label the query's pending sample positive, expire
+    // samples that left the window as negative, and update its history.
+    void observe(const std::string &query, const CacheEntry &entry)
+    {
+        now++;
+        auto pending = sampled_at.find(query);
+        if (pending != sampled_at.end())
+        {
+            auto sample = std::lower_bound(window.begin(), window.end(), pending->second, [](const Sample &s, uint32_t time)
+                                           { return s.time < time; });
+            if (sample != window.end() && sample->time == pending->second && !sample->labeled)
+            {
+                sample->labeled = true;
+                emit(sample->features, true);
+            }
+            sampled_at.erase(pending);
+        }
+        while (!window.empty() && now - window.front().time > boundary())
+        {
+            Sample &expired = window.front();
+            if (!expired.labeled)
+                emit(expired.features, false);
+            auto newest = sampled_at.find(expired.query);
+            if (newest != sampled_at.end() && newest->second == expired.time)
+                sampled_at.erase(newest);
+            window.pop_front();
+        }
+
+        auto known = resident.find(query);
+        if (known == resident.end())
+        {
+            auto node = past.extract(query);
+            known = node ? resident.insert(std::move(node)).position : resident.emplace(query, History()).first;
+        }
+        History &seen = known->second;
+        if (seen.count > 0)
+        {
+            seen.gaps[2] = seen.gaps[1];
+            seen.gaps[1] = seen.gaps[0];
+            seen.gaps[0] = now - seen.last;
+        }
+        seen.last = now;
+        seen.count++;
+        for (int i = 0; i < 3; i++)
+        {
+            // An unknown gap reads as one well past the boundary.
+            seen.features[1 + i] = scaled_log(seen.gaps[i] ? seen.gaps[i] : 4 * boundary());
+        }
+        seen.features[4] = scaled_log(seen.count);
+        seen.features[5] = scaled_log(query.size() + entry.size_bytes());
+        seen.features[6] = scaled_log(entry.cost_ms);
+        seen.features[7] = query.compare(0, 7, "select ") == 0 ? 1.0f : 0.0f;
+    }
+
+    // Move a departing entry's history aside for when it returns.
+    void retire(const std::string &query)
+    {
+        auto node = resident.extract(query);
+        if (!node)
+            return;
+        past_order.push_back({query, node.mapped().last});
+        past.insert(std::move(node));
+        if (past_order.size() > (size_t)capacity * 8)
+        {
+            // A query retired again since keeps its newer history.
+            auto oldest = past.find(past_order.front().first);
+            if (oldest != past.end() && oldest->second.last == past_order.front().second)
+                past.erase(oldest);
+            past_order.pop_front();
+        }
+    }
+
+    void train_loop()
+    {
+        Weights local = weights;
+        std::unique_lock<std::mutex> lock(train_mutex);
+        while (true)
+        {
+            train_ready.wait(lock, [this]()
+                             { return stopping || queued.size() >= 64; });
+            if (stopping)
+                return;
+            std::vector<Labeled> batch;
+            batch.swap(queued);
+            lock.unlock();
+            for (const auto &sample : batch)
+            {
+                float error = 1 / (1 + std::exp(-margin(local, sample.features))) - sample.label;
+                for (int i = 0; i < feature_count; i++)
+                {
+                    local[i] -= learning_rate * error * sample.features[i];
+                }
+                local[feature_count] -= learning_rate * error;
+            }
+            {
+                std::lock_guard<std::mutex> guard(model_mutex);
+                weights = local;
+            }
+            trained += batch.size();
+            lock.lock();
+        }
+    }
+
+public:
+    int samples = 16;              // Candidates scored per eviction.
+    int samples_labeled = 4;       // Entries sampled per miss as training samples.
+    double boundary_factor = 1.0;  // Reuse window in multiples of the capacity.
+    float learning_rate = 0.1f;
+
+    LearnedCache(int cap) : CacheStrategy(cap), rng(42), now(0), stopping(false), trained(0), evictions(0), evict_ns(0)
+    {
+        // Until trained, prefer evicting the longest idle: plain LRU.
+        weights.fill(0);
+        weights[0] = -8;
+        weights[feature_count] = 2;
+        trainer = std::thread(&LearnedCache::train_loop, this);
+    }
+
+    ~LearnedCache()
+    {
+        {
+            std::lock_guard<std::mutex> guard(train_mutex);
+            stopping = true;
+        }
+        train_ready.notify_one();
+        trainer.join();
+    }
+
+    // Each miss also picks a few resident entries for the request stream
+    // to label. Sampling here rather than at eviction keeps the training
+    // stream steady when evictions come in batches.
+    void admit(const std::string &query) override
+    {
+        observe(query, cache[query]);
+        sample_buckets(resident, rng, samples_labeled, [&](const std::string &candidate, const History &seen)
+                       {
+            if (sampled_at.count(candidate))
+                return;
+            Features x = seen.features;
+            x[0] = scaled_log(now - seen.last);
+            window.push_back({now, candidate, x, false});
+            sampled_at[candidate] = now; });
+    }
+
+    void update(const std::string &query) override
+    {
+        auto it = cache.find(query);
+        if (it != cache.end())
+            observe(query, it->second);
+    }
+
+    void evict() override
+    {
+        auto start = std::chrono::steady_clock::now();
+        Weights model;
+        {
+            std::lock_guard<std::mutex> guard(model_mutex);
+            model = weights;
+        }
+        std::string victim;
+        float lowest = HUGE_VALF;
+        sample_buckets(resident, rng, samples, [&](const std::string &query, const History &seen)
+                       {
+            Features x = seen.features;
+            x[0] = scaled_log(now - seen.last);
+            float reuse = margin(model, x);
+            if (reuse < lowest)
+            {
+                lowest = reuse;
+                victim = query;
+            } });
+        if (victim.empty() && !resident.empty())
+            victim = resident.begin()->first;
+        if (victim.empty())
+            return;
+        retire(victim);
+        erase_entry(victim);
+        evictions++;
+        evict_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        if (verbose)
+            std::cout << "Learned Evicted: " << victim << "\n";
+    }
+
+    void forget(const std::string &query) override { retire(query); }
+
+    void stats() override
+    {
+        CacheStrategy::stats();
+        std::cout << "Learned Model: " << trained << " samples trained, "
+                  << (evictions ? evict_ns / evictions : 0) << " ns per eviction\n";
+    }
+};
+
+// Composable Cache Policies
+//
+// Cache<Metadata, Admission, Eviction, Weigher> assembles a strategy from
+// independent parts chosen at compile time:
+//   Metadata  - the key -> per-entry state map the eviction policy and the
+//               weigher keep; the entries themselves always live in
+//               CacheStrategy::cache;
+//   Admission - decides whether a new entry may displace the next victim;
+//   Eviction  - orders resident entries, names the next victim and may
+//               vouch for a candidate it has recent history for; it may
+//               also expose one parameter for the hill climber to tune;
+//   Weigher   - charges each entry against a budget of capacity * unit.
+// Policy calls are plain member calls the compiler can inline; the only
+// virtual dispatch is the CacheStrategy interface itself, which serves as
+// the type-erased wrapper set_cache_strategy works with.
+
+struct HashMetadata
+{
+    template <class Value>
+    using map = HugePageMap<Value>;
+};
+
+struct AlwaysAdmit
+{
+    void record(const std::string &) {}
+    bool admit(const std::string &, const std::string &, bool, size_t, size_t) { return true; }
+};
+
+// TinyLFU: admit a candidate only if it has been requested more often than
+// the entry it would displace.
+struct FrequencyAdmission
+{
+    AdmissionSketch sketch;
+
+    void record(const std::string &key) { sketch.record_access(key); }
+    bool admit(const std::string &candidate, const std::string &victim, bool, size_t, size_t)
+    {
+        return victim.empty() || sketch.accesses(candidate) > sketch.accesses(victim);
+    }
+};
+
+// Hybrid LIRS/TinyLFU admission for new HIR blocks. A candidate the
+// eviction policy vouches for (a non-resident HIR block still in the LIRS
+// stack, i.e. one with a short inter-reference recency) is always admitted,
+// as LIRS would. Anything else must beat frequency_weight times the
+// victim's sketch frequency: 0 is plain LIRS, 1 is plain TinyLFU gating.
+struct RecencyFrequencyAdmission
+{
+    AdmissionSketch sketch;
+    double frequency_weight = 1.0;
+
+    void record(const std::string &key) { sketch.record_access(key); }
+    bool admit(const std::string &candidate, const std::string &victim, bool recent, size_t, size_t)
+    {
+        return victim.empty() || recent || sketch.accesses(candidate) > frequency_weight * sketch.accesses(victim);
+    }
+};
+
+// Refuse entries heavier than a quarter of the budget outright.
+struct SizeAdmission
+{
+    void record(const std::string &) {}
+    bool admit(const std::string &, const std::string &, bool, size_t weight, size_t budget)
+    {
+        return weight * 4 <= budget;
+    }
+};
+
+struct UnitWeigher
+{
+    static const size_t unit = 1;
+    size_t operator()(const std::string &, const CacheEntry &) const { return 1; }
+};
+
+struct ByteWeigher
+{
+    static const size_t unit = 4096;
+    size_t operator()(const std::string &key, const CacheEntry &entry) const { return key.size() + entry.size_bytes(); }
+};
+
+// Least recently used first.
+template <class Metadata>
+class LruEviction
+{
+    std::list<std::string> order; // Oldest at the front.
+    typename Metadata::template map<std::list<std::string>::iterator> position;
+
+public:
+    explicit LruEviction(size_t = 0) {}
+    static const char *name() { return "LRU"; }
+    bool recent(const std::string &) const { return false; }
+    double *tuning_parameter(const char *&, double &, double &) { return nullptr; }
+    void rebalance() {}
+    void resize(size_t) {}
+
+    void insert(const std::string &key) { position[key] = order.insert(order.end(), key); }
+    void touch(const std::string &key)
+    {
+        auto it = position.find(key);
+        if (it != position.end())
+            order.splice(order.end(), order, it->second);
+    }
+    std::string victim() const { return order.empty() ? "" : order.front(); }
+    void remove(const std::string &key)
+    {
+        auto it = position.find(key);
+        if (it == position.end())
+            return;
+        order.erase(it->second);
+        position.erase(it);
+    }
+};
+
+// Same queue progression as S3FIFOCache: new entries start in the short
+// queue and each hit promotes one queue up. Victims come from the short
+// queue while it holds more than small_ratio of the slots, and otherwise
+// from the lowest non-empty queue above it, in FIFO order.
+template <class Metadata>
+class S3FifoEviction
+{
+    std::list<std::string> queues[3];
+    typename Metadata::template map<std::pair<int, std::list<std::string>::iterator>> position;
+    size_t capacity;
+
+public:
+    double small_ratio = 0.1;
+
+    explicit S3FifoEviction(size_t cap = 0) : capacity(std::max<size_t>(cap, 1)) {}
+    static const char *name() { return "S3-FIFO"; }
+    bool recent(const std::string &) const { return false; }
+    double *tuning_parameter(const char *&parameter, double &low, double &high)
+    {
+        parameter = "small_ratio";
+        low = 0.01;
+        high = 0.9;
+        return &small_ratio;
+    }
+    void rebalance() {}
+    // The small queue's share is a ratio, so it scales with the capacity.
+    void resize(size_t cap) { capacity = std::max<size_t>(cap, 1); }
+
+    void insert(const std::string &key) { position[key] = {0, queues[0].insert(queues[0].end(), key)}; }
+    void touch(const std::string &key)
+    {
+        auto it = position.find(key);
+        if (it == position.end())
+            return;
+        int level = std::min(it->second.first + 1, 2);
+        queues[level].splice(queues[level].end(), queues[it->second.first], it->second.second);
+        it->second.first = level;
+    }
+    std::string victim() const
+    {
+        if (!queues[0].empty() && queues[0].size() > capacity * small_ratio)
+            return queues[0].front();
+        for (int level = 1; level < 3; level++)
+        {
+            if (!queues[level].empty())
+                return queues[level].front();
+        }
+        return queues[0].empty() ? "" : queues[0].front();
+    }
+    void remove(const std::string &key)
+    {
+        auto it = position.find(key);
+        if (it == position.end())
+            return;
+        queues[it->second.first].erase(it->second.second);
+        position.erase(it);
+    }
+};
+
+// LIRS proper: the stack S holds LIR blocks and recently seen HIR blocks,
+// resident or not, in recency order; the queue Q holds the resident HIR
+// blocks and supplies victims. A HIR block re-referenced while still in S
+// has a shorter inter-reference recency than the oldest LIR block, so the
+// two swap status. hir_ratio sets the share of slots left to HIR blocks.
+template <class Metadata>
+class LirsEviction
+{
+    enum Status
+    {
+        Lir,
+        ResidentHir,
+        GhostHir
+    };
+
+    struct Node
+    {
+        Status status;
+        bool in_stack;
+        std::list<std::string>::iterator stack_pos;
+        bool in_queue;
+        std::list<std::string>::iterator queue_pos;
+    };
+
+    std::list<std::string> stack; // S, most recent at the back.
+    std::list<std::string> queue; // Q, next victim at the front.
+    typename Metadata::template map<Node> nodes;
+    size_t capacity;
+    size_t lir_count;
+    size_t ghost_count;
+
+    size_t lir_capacity() const
+    {
+        size_t hir = std::max<size_t>(1, (size_t)std::lround(capacity * hir_ratio));
+        return capacity > hir ? capacity - hir : 1;
+    }
+
+    void push_stack(const std::string &key, Node &node)
+    {
+        if (node.in_stack)
+            stack.erase(node.stack_pos);
+        node.stack_pos = stack.insert(stack.end(), key);
+        node.in_stack = true;
+    }
+
+    void push_queue(const std::string &key, Node &node)
+    {
+        if (node.in_queue)
+            queue.erase(node.queue_pos);
+        node.queue_pos = queue.insert(queue.end(), key);
+        node.in_queue = true;
+    }
+
+    // Pop HIR blocks off the bottom of S so that it always ends in a LIR block.
+    void prune()
+    {
+        while (!stack.empty())
+        {
+            auto it = nodes.find(stack.front());
+            if (it->second.status == Lir)
+                break;
+            stack.pop_front();
+            it->second.in_stack = false;
+            if (it->second.status == GhostHir)
+            {
+                ghost_count--;
+                nodes.erase(it);
+            }
+        }
+    }
+
+    // Turn the oldest LIR block into a resident HIR block at the end of Q.
+    void demote_bottom()
+    {
+        if (stack.empty())
+            return;
+        std::string key = stack.front();
+        Node &node = nodes[key];
+        stack.pop_front();
+        node.in_stack = false;
+        node.status = ResidentHir;
+        lir_count--;
+        push_queue(key, node);
+        prune();
+    }
+
+    void make_lir(const std::string &key, Node &node)
+    {
+        if (node.in_queue)
+        {
+            queue.erase(node.queue_pos);
+            node.in_queue = false;
+        }
+        if (node.status == GhostHir)
+            ghost_count--;
+        node.status = Lir;
+        lir_count++;
+        push_stack(key, node);
+        if (lir_count > lir_capacity())
+            demote_bottom();
+        prune();
+    }
+
+    // Bound the non-resident history to twice the cache size.
+    void trim_ghosts()
+    {
+        for (auto it = stack.begin(); ghost_count > 2 * capacity && it != stack.end();)
+        {
+            auto node = nodes.find(*it);
+            if (node->second.status != GhostHir)
+            {
+                ++it;
+                continue;
+            }
+            it = stack.erase(it);
+            nodes.erase(node);
+            ghost_count--;
+        }
+    }
+
+public:
+    double hir_ratio = 0.1;
+
+    explicit LirsEviction(size_t cap = 0) : capacity(std::max<size_t>(cap, 2)), lir_count(0), ghost_count(0) {}
+    static const char *name() { return "LIRS"; }
+
+    double *tuning_parameter(const char *&parameter, double &low, double &high)
+    {
+        parameter = "hir_ratio";
+        low = 0.01;
+        high = 0.5;
+        return &hir_ratio;
+    }
+
+    // After hir_ratio grows, demote the oldest LIR blocks until they fit.
+    void rebalance()
+    {
+        while (lir_count > lir_capacity() && !stack.empty())
+            demote_bottom();
+    }
+
+    // Both LIR and HIR shares follow the capacity. On a shrink the oldest
+    // LIR blocks are demoted and leave through Q; on a grow HIR blocks are
+    // promoted as they are re-referenced.
+    void resize(size_t cap)
+    {
+        capacity = std::max<size_t>(cap, 2);
+        rebalance();
+    }
+
+    // True for a non-resident block that is still in S.
+    bool recent(const std::string &key) const
+    {
+        auto it = nodes.find(key);
+        return it != nodes.end() && it->second.status == GhostHir && it->second.in_stack;
+    }
+
+    void insert(const std::string &key)
+    {
+        auto it = nodes.find(key);
+        if (it == nodes.end())
+            it = nodes.emplace(key, Node{ResidentHir, false, {}, false, {}}).first;
+        Node &node = it->second;
+        if (lir_count < lir_capacity() || (node.status == GhostHir && node.in_stack))
+        {
+            make_lir(key, node);
+            return;
+        }
+        if (node.status == GhostHir)
+            ghost_count--;
+        node.status = ResidentHir;
+        push_stack(key, node);
+        push_queue(key, node);
+    }
+
+    void touch(const std::string &key)
+    {
+        auto it = nodes.find(key);
+        if (it == nodes.end() || it->second.status == GhostHir)
+            return;
+        Node &node = it->second;
+        if (node.status == Lir)
+        {
+            push_stack(key, node);
+            prune();
+        }
+        else if (node.in_stack)
+        {
+            make_lir(key, node);
+        }
+        else
+        {
+            push_stack(key, node);
+            push_queue(key, node);
+        }
+    }
+
+    std::string victim() const
+    {
+        if (!queue.empty())
+            return queue.front();
+        return stack.empty() ? "" : stack.front();
+    }
+
+    // Evicted or invalidated: a resident HIR block stays in S as history.
+    void remove(const std::string &key)
+    {
+        auto it = nodes.find(key);
+        if (it == nodes.end() || it->second.status == GhostHir)
+            return;
+        Node &node = it->second;
+        if (node.in_queue)
+        {
+            queue.erase(node.queue_pos);
+            node.in_queue = false;
+        }
+        if (node.status == Lir)
+        {
+            lir_count--;
+            stack.erase(node.stack_pos);
+            nodes.erase(it);
+        }
+        else if (node.in_stack)
+        {
+            node.status = GhostHir;
+            ghost_count++;
+            trim_ghosts();
+        }
+        else
+        {
+            nodes.erase(it);
+        }
+        prune();
+    }
+};
+
+// W-TinyLFU: new entries enter a small LRU window. Once the window is full,
+// its oldest entry competes for a slot in the main LRU with the main's
+// oldest, and whichever the frequency sketch has seen less often is the
+// victim. window_ratio sets the window's share of the slots.
+template <class Metadata>
+class WindowTinyLfuEviction
+{
+    std::list<std::string> window; // Oldest at the front.
+    std::list<std::string> main;
+    typename Metadata::template map<std::pair<bool, std::list<std::string>::iterator>> position; // (in main, position)
+    AdmissionSketch sketch;
+    size_t capacity;
+
+    size_t window_capacity() const { return std::max<size_t>(1, (size_t)std::lround(capacity * window_ratio)); }
+
+public:
+    double window_ratio = 0.01;
+
+    explicit WindowTinyLfuEviction(size_t cap = 0) : capacity(std::max<size_t>(cap, 2)) {}
+    static const char *name() { return "W-TinyLFU"; }
+    bool recent(const std::string &) const { return false; }
+    double *tuning_parameter(const char *&parameter, double &low, double &high)
+    {
+        parameter = "window_ratio";
+        low = 0.01;
+        high = 0.8;
+        return &window_ratio;
+    }
+
+    // Move window overflow into the main area while it has free slots.
+    void rebalance()
+    {
+        while (window.size() > window_capacity() && main.size() < capacity - std::min(capacity, window_capacity()))
+        {
+            auto it = position.find(window.front());
+            main.splice(main.end(), window, window.begin());
+            it->second.first = true;
+        }
+    }
+
+    void resize(size_t cap)
+    {
+        capacity = std::max<size_t>(cap, 2);
+        rebalance();
+    }
+
+    void insert(const std::string &key)
+    {
+        sketch.record_access(key);
+        position[key] = {false, window.insert(window.end(), key)};
+        rebalance();
+    }
+    void touch(const std::string &key)
+    {
+        auto it = position.find(key);
+        if (it == position.end())
+            return;
+        sketch.record_access(key);
+        std::list<std::string> &list = it->second.first ? main : window;
+        list.splice(list.end(), list, it->second.second);
+    }
+    std::string victim() const
+    {
+        if (window.size() >= window_capacity() && !window.empty() && !main.empty())
+        {
+            const std::string &candidate = window.front();
+            const std::string &incumbent = main.front();
+            return sketch.accesses(candidate) > sketch.accesses(incumbent) ? incumbent : candidate;
+        }
+        if (!main.empty())
+            return main.front();
+        return window.empty() ? "" : window.front();
+    }
+    void remove(const std::string &key)
+    {
+        auto it = position.find(key);
+        if (it == position.end())
+            return;
+        (it->second.first ? main : window).erase(it->second.second);
+        position.erase(it);
+    }
+};
+
+// Caffeine-style hill climber over one policy parameter. Every epoch of
+// sample_size requests it compares the hit ratio with the previous epoch's:
+// if it did not get worse the parameter keeps moving the same way,
+// otherwise it turns around. The step decays each epoch so the value
+// settles, and is restored when the hit ratio jumps, which signals a
+// workload shift. The parameter always stays within [low, high].
+class HillClimber
+{
+    double *parameter = nullptr;
+    double low = 0;
+    double high = 0;
+    double initial_step = 0;
+    double step = 0;
+    int direction = 1;
+    double previous = -1; // Hit ratio of the last epoch, -1 before the first.
+    long start_hits = 0;
+    long start_requests = 0;
+
+public:
+    const char *name = "";
+    long sample_size = 0;
+    double decay = 0.98;
+    double restart_threshold = 0.05;
+    int adjustments = 0;
+
+    void attach(const char *parameter_name, double *value, double min, double max, double first_step, long sample)
+    {
+        name = parameter_name;
+        parameter = value;
+        low = min;
+        high = max;
+        initial_step = step = first_step;
+        sample_size = sample;
+    }
+
+    bool attached() const { return parameter != nullptr; }
+    double value() const { return parameter ? *parameter : 0; }
+
+    // Feed cumulative hit and request counts. Returns true if the
+    // parameter was moved.
+    bool sample(long hits, long requests)
+    {
+        if (!parameter || requests - start_requests < sample_size)
+            return false;
+        double ratio = double(hits - start_hits) / (requests - start_requests);
+        start_hits = hits;
+        start_requests = requests;
+        if (previous >= 0)
+        {
+            double change = ratio - previous;
+            if (change < 0)
+                direction = -direction;
+            step = std::fabs(change) >= restart_threshold ? initial_step : step * decay;
+        }
+        previous = ratio;
+        double next = std::min(high, std::max(low, *parameter + direction * step));
+        if (next == *parameter)
+            return false;
+        *parameter = next;
+        adjustments++;
+        return true;
+    }
+};
+
+template <class Metadata, class Admission, template <class> class Eviction, class Weigher>
+class Cache : public CacheStrategy
+{
+    Admission admission;
+    Eviction<Metadata> eviction;
+    Weigher weigher;
+    typename Metadata::template map<size_t> weights;
+    size_t total_weight;
+    HillClimber tuner;
+
+    size_t budget() const { return (size_t)capacity * Weigher::unit; }
+
+    void evict_one()
+    {
+        std::string victim = eviction.victim();
+        if (victim.empty())
+            return;
+        eviction.remove(victim);
+        release(victim);
+        erase_entry(victim);
+        if (verbose)
+            std::cout << Eviction<Metadata>::name() << " Evicted: " << victim << "\n";
+    }
+
+    void release(const std::string &key)
+    {
+        auto it = weights.find(key);
+        if (it == weights.end())
+            return;
+        total_weight -= it->second;
+        weights.erase(it);
+    }
+
+public:
+    bool auto_tune; // Let the hill climber move the eviction policy's parameter.
+
+    Cache(int cap, bool tuned = true) : CacheStrategy(cap), eviction(cap), total_weight(0), auto_tune(tuned)
+    {
+        const char *name = "";
+        double low = 0, high = 0;
+        double *parameter = eviction.tuning_parameter(name, low, high);
+        if (parameter)
+            tuner.attach(name, parameter, low, high, 0.03, 25L * cap);
+    }
+
+    Admission &admission_policy() { return admission; }
+    Eviction<Metadata> &eviction_policy() { return eviction; }
+
+    bool accept(const std::string &query, const CacheEntry &entry) override
+    {
+        admission.record(query);
+        size_t weight = weigher(query, entry);
+        bool full = cache.size() >= (size_t)capacity || total_weight + weight > budget();
+        return admission.admit(query, full ? eviction.victim() : "", eviction.recent(query), weight, budget());
+    }
+
+    // Once per epoch, nudge the tuned parameter and adjust to its new value
+    // in place.
+    void tune()
+    {
+        if (auto_tune && tuner.sample(cache_hits, cache_hits + cache_misses))
+            eviction.rebalance();
+    }
+
+    void admit(const std::string &query) override
+    {
+        tune();
+        // An adopted entry is already weighed; weigh it again in case it changed.
+        size_t &weight = weights[query];
+        total_weight -= weight;
+        weight = weigher(query, cache[query]);
+        total_weight += weight;
+        // Make room by weight, never evicting the entry just admitted.
+        while (total_weight > budget() && eviction.victim() != "")
+        {
+            inline_evictions++;
+            evict_one();
+        }
+        eviction.insert(query);
+    }
+
+    void adopted(const std::string &query) override
+    {
+        size_t weight = weigher(query, cache[query]);
+        weights[query] = weight;
+        total_weight += weight;
+    }
+
+    void update(const std::string &query) override
+    {
+        tune();
+        admission.record(query);
+        eviction.touch(query);
+    }
+
+    void evict() override { evict_one(); }
+
+    void forget(const std::string &query) override
+    {
+        eviction.remove(query);
+        release(query);
+    }
+
+    void resized(int) override
+    {
+        eviction.resize(capacity);
+        tuner.sample_size = 25L * capacity;
+    }
+
+    double fill() const override { return std::max(CacheStrategy::fill(), double(total_weight) / budget()); }
+
+    void stats() override
+    {
+        CacheStrategy::stats();
+        if (tuner.attached())
+            std::cout << "Tuned " << Eviction<Metadata>::name() << " " << tuner.name << ": " << tuner.value()
+                      << " (" << tuner.adjustments << " adjustments" << (auto_tune ? "" : ", tuning off") << ")\n";
+    }
+};
+
+// The README's hybrid LIRS + TinyLFU: LIRS stack/queue for the resident
+// set, with new HIR blocks gated by the frequency sketch.
+using HybridCache = Cache<HashMetadata, RecencyFrequencyAdmission, LirsEviction, UnitWeigher>;
+
+// Compositions selectable by name as "<admission>+<eviction>". Unless
+// tuned is false, a tunable eviction parameter is hill climbed online.
+CacheStrategy *make_composed_cache(const std::string &name, int capacity, bool tuned = true)
+{
+    if (name == "tinylfu+s3fifo")
+        return new Cache<HashMetadata, FrequencyAdmission, S3FifoEviction, UnitWeigher>(capacity, tuned);
+    if (name == "tinylfu+lru")
+        return new Cache<HashMetadata, FrequencyAdmission, LruEviction, UnitWeigher>(capacity, tuned);
+    if (name == "tinylfu+lirs")
+        return new Cache<HashMetadata, FrequencyAdmission, LirsEviction, UnitWeigher>(capacity, tuned);
+    if (name == "hybrid" || name == "lirs+tinylfu")
+        return new HybridCache(capacity, tuned);
+    if (name == "w-tinylfu")
+        return new Cache<HashMetadata, AlwaysAdmit, WindowTinyLfuEviction, UnitWeigher>(capacity, tuned);
+    if (name == "lirs-stack")
+        return new Cache<HashMetadata, AlwaysAdmit, LirsEviction, UnitWeigher>(capacity, tuned);
+    if (name == "size+lirs")
+        return new Cache<HashMetadata, SizeAdmission, LirsEviction, ByteWeigher>(capacity, tuned);
+    if (name == "size+s3fifo")
+        return new Cache<HashMetadata, SizeAdmission, S3FifoEviction, ByteWeigher>(capacity, tuned);
+    if (name == "lru")
+        return new Cache<HashMetadata, AlwaysAdmit, LruEviction, UnitWeigher>(capacity, tuned);
+    return nullptr;
+}
+
+// Build a strategy from its menu name, setting label to its display name.
+// Returns nullptr for an unknown name.
+CacheStrategy *make_strategy(const std::string &name, int capacity, std::string &label)
+{
+    label = name;
+    if (name == "lirs")
+    {
+        label = "LIRS";
+        return new LIRSCache(capacity);
+    }
+    if (name == "tinyflu")
+    {
+        label = "TinyFLU";
+        return new TinyFLUCache(capacity);
+    }
+    if (name == "s3fifo" || name == "s3-fifo") // Accept both formats
+    {
+        label = "S3-FIFO";
+        return new S3FIFOCache(capacity);
+    }
+    if (name == "gdsf")
+    {
+        label = "GDSF";
+        return new GDSFCache(capacity);
+    }
+    if (name == "arc")
+    {
+        label = "ARC";
+        return new ARCCache(capacity);
+    }
+    if (name == "clock")
+    {
+        label = "CLOCK";
+        return new CLOCKCache(capacity);
+    }
+    if (name == "sieve")
+    {
+        label = "SIEVE";
+        return new CLOCKCache(capacity, true);
+    }
+    if (name == "clock-pro" || name == "clockpro")
+    {
+        label = "CLOCK-Pro";
+        return new CLOCKProCache(capacity);
+    }
+    if (name == "learned")
+    {
+        label = "Learned";
+        return new LearnedCache(capacity);
+    }
+    if (name == "sampled-lru" || name == "sampled-lfu")
+    {
+        label = name == "sampled-lfu" ? "Sampled-LFU" : "Sampled-LRU";
+        return new SampledCache(capacity, name == "sampled-lfu");
+    }
+    return make_composed_cache(name, capacity);
+}
+
+// Shadow Policy Selection
+//
+// SHARDS-style sampling: only fingerprints whose hash falls in a fixed
+// slice of the hash space are replayed, against mini caches scaled down by
+// the same rate, so each mini cache sees the live stream's reuse pattern
+// at a fraction of the cost. A background thread replays the sampled keys
+// against one mini cache per candidate policy and compares their hit
+// ratios window by window. When a candidate beats the live policy's mini
+// cache by at least margin points for confirm_windows windows in a row, it
+// is recommended and becomes the new live policy.
+class ShadowSelector
+{
+    struct Shadow
+    {
+        std::string name;
+        std::unique_ptr<CacheStrategy> cache;
+        long window_hits = 0;
+        double last_ratio = 0; // Hit ratio (%) of the last complete window.
+    };
+
+    static const size_t slices = 1024;
+    static const int min_shadow_entries = 64;
+
+    std::vector<Shadow> shadows;
+    size_t sampled_slices;
+    double rate; // sampled_slices / slices.
+    std::string live;
+
+    std::deque<std::string> queue; // Sampled keys waiting to be replayed.
+    std::mutex mutex;              // Guards queue, live, recommended and the reported ratios.
+    std::condition_variable ready;
+    bool stopping;
+    int pending_capacity; // Live capacity to rescale the mini caches to, or 0.
+    std::string recommended;
+    std::string leader;
+    int leader_windows;
+    long window_requests;
+    long windows;
+    std::thread worker;
+
+    // Close a window: find the best mini cache and apply hysteresis.
+    void close_window()
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        const Shadow *best = nullptr;
+        const Shadow *current = nullptr;
+        for (auto &shadow : shadows)
+        {
+            shadow.last_ratio = 100.0 * shadow.window_hits / window_requests;
+            shadow.window_hits = 0;
+            if (!best || shadow.last_ratio > best->last_ratio)
+                best = &shadow;
+            if (shadow.name == live)
+                current = &shadow;
+        }
+        window_requests = 0;
+        windows++;
+        if (!current || best == current || best->last_ratio < current->last_ratio + margin)
+        {
+            leader_windows = 0;
+            return;
+        }
+        leader_windows = leader == best->name ? leader_windows + 1 : 1;
+        leader = best->name;
+        if (leader_windows >= confirm_windows)
+        {
+            recommended = live = leader;
+            leader_windows = 0;
+        }
+    }
+
+    int shadow_capacity(int capacity) const { return std::max(1, (int)std::lround(capacity * rate)); }
+
+    // Resize every mini cache for a new live capacity, evicting any surplus
+    // at once. The sampling rate stays put so the mini caches keep seeing
+    // the keys they already hold; the window in progress mixes both sizes
+    // and is discarded.
+    void rescale(int capacity)
+    {
+        for (auto &shadow : shadows)
+        {
+            shadow.cache->resize(shadow_capacity(capacity));
+            while (shadow.cache->trim(min_shadow_entries))
+            {
+            }
+            shadow.window_hits = 0;
+        }
+        window_requests = 0;
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            ready.wait(lock, [this]()
+                       { return stopping || !queue.empty() || pending_capacity > 0; });
+            if (stopping)
+                return;
+            std::deque<std::string> batch;
+            batch.swap(queue);
+            int capacity = pending_capacity;
+            pending_capacity = 0;
+            lock.unlock();
+            if (capacity > 0)
+                rescale(capacity);
+            for (const auto &key : batch)
+            {
+                for (auto &shadow : shadows)
+                {
+                    if (!shadow.cache->get(key).empty())
+                    {
+                        shadow.window_hits++;
+                        continue;
+                    }
+                    CacheEntry entry;
+                    entry.result = "r";
+                    entry.cost_ms = 1;
+                    shadow.cache->put(key, std::move(entry));
+                }
+                if (++window_requests >= window)
+                    close_window();
+            }
+            lock.lock();
+        }
+    }
+
+public:
+    long window = 200;         // Sampled requests per comparison window.
+    double margin = 2.0;       // Hit ratio points a challenger must lead by.
+    int confirm_windows = 3;   // Consecutive windows it must lead for.
+    size_t max_queue = 4096;   // Sampled keys dropped beyond this backlog.
+
+    ShadowSelector(const std::vector<std::string> &candidates, const std::string &live_policy, int capacity)
+        : live(live_policy), stopping(false), pending_capacity(0), leader_windows(0), window_requests(0), windows(0)
+    {
+        rate = std::min(1.0, double(min_shadow_entries) / capacity);
+        sampled_slices = std::max<size_t>(1, (size_t)std::lround(rate * slices));
+        // Size the mini caches by the rate actually sampled, which rounding
+        // and the one-slice floor can move well away from the ideal one.
+        rate = double(sampled_slices) / slices;
+        std::vector<std::string> names = candidates;
+        if (std::find(names.begin(), names.end(), live_policy) == names.end())
+            names.push_back(live_policy);
+        for (const auto &name : names)
+        {
+            std::string label;
+            Shadow shadow;
+            shadow.name = name;
+            shadow.cache.reset(make_strategy(name, shadow_capacity(capacity), label));
+            if (!shadow.cache)
+                continue;
+            shadow.cache->verbose = false;
+            shadow.cache->admission_ratio = 0;
+            shadows.push_back(std::move(shadow));
+        }
+        worker = std::thread(&ShadowSelector::run, this);
+    }
+
+    ~ShadowSelector()
+    {
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            stopping = true;
+        }
+        ready.notify_one();
+        worker.join();
+    }
+
+    // Offer a key from the live access stream; only the sampled slice is kept.
+    void record(const std::string &key)
+    {
+        if (std::hash<std::string>{}(key) % slices >= sampled_slices)
+            return;
+        std::lock_guard<std::mutex> guard(mutex);
+        if (queue.size() >= max_queue)
+            return;
+        queue.push_back(key);
+        ready.notify_one();
+    }
+
+    // Follow a change of the live cache's capacity. The worker rescales the
+    // mini caches before it replays more keys.
+    void resize(int capacity)
+    {
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            pending_capacity = std::max(1, capacity);
+        }
+        ready.notify_one();
+    }
+
+    // Take the pending switch recommendation, if any.
+    bool recommendation(std::string &name)
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (recommended.empty())
+            return false;
+        name.swap(recommended);
+        recommended.clear();
+        return true;
+    }
+
+    void stats()
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        std::cout << "Shadow Policies (" << windows << " windows, sampling " << sampled_slices << "/" << slices
+                  << " of keys, live " << live << "):";
+        for (const auto &shadow : shadows)
+        {
+            std::cout << " " << shadow.name << " " << shadow.last_ratio << "%";
+        }
+        std::cout << "\n";
+    }
+};
+
+// Incrementally Maintained Aggregates
+
+// A cached COUNT/SUM/MIN/MAX/AVG over a whole table or an equality predicate.
+struct AggregateView
+{
+    std::string plan;
+    std::string function;
+    std::string header;     // Result column name, e.g. "count(*)".
+    int value_column = -1;  // -1 for COUNT(*).
+    int filter_column = -1; // -1 without a predicate.
+    std::string filter_value;
+    AggregateState state;
+    unsigned long version = 0; // Commit timestamp the state reflects.
+    std::string table;
+    unsigned long last_used = 0; // AggregateCache clock at the last install or hit.
+
+    bool selects(const std::vector<std::string> &row) const
+    {
+        return filter_column < 0 || compare_values(row[filter_column], filter_value) == 0;
+    }
+
+    // Fold one committed row change into the state. Returns false if the view
+    // can no longer be maintained and must be dropped.
+    bool apply(const RowChange &change)
+    {
+        if (change.before.empty() && change.after.empty())
+            return false;
+        bool count_star = value_column < 0;
+        if (!change.before.empty() && selects(change.before))
+        {
+            bool extremes_known = state.remove(count_star ? "" : change.before[value_column], count_star);
+            if (!extremes_known && (function == "min" || function == "max"))
+                return false;
+        }
+        if (!change.after.empty() && selects(change.after))
+            state.add(count_star ? "" : change.after[value_column], count_star);
+        version = change.commit_ts;
+        return state.numeric || function == "count";
+    }
+
+    std::string render() const
+    {
+        ResultSet result;
+        result.columns.push_back(header);
+        result.rows.push_back({state.render(function)});
+        return ExecutionEngine::render(plan, result);
+    }
 };
 
-/// S3-FIFO Cache Implementation
-class S3FIFOCache : public CacheStrategy
+// Aggregate results that committed DML updates in place through row deltas
+// instead of invalidating them. Views only serve snapshots at or after the
+// commit they reflect; older readers fall back to the regular cache.
+class AggregateCache
 {
-    std::deque<std::string> short_term;
-    std::deque<std::string> medium_term;
-    std::deque<std::string> long_term;
+    static const size_t max_views = 64;
+    std::unordered_map<std::string, AggregateView> views;
+    std::unordered_map<std::string, std::set<std::string>> table_index; // table -> fingerprints
+    int hits = 0;
+    int misses = 0;
+    long deltas_applied = 0;
+    int views_dropped = 0;
+    int views_evicted = 0;
+    unsigned long clock = 0;
+
+    void drop(const std::string &key, const std::string &table)
+    {
+        views.erase(key);
+        auto it = table_index.find(table);
+        if (it != table_index.end())
+        {
+            it->second.erase(key);
+            if (it->second.empty())
+                table_index.erase(it);
+        }
+    }
 
 public:
-    S3FIFOCache(int cap) : CacheStrategy(cap) {}
+    static bool eligible(const QueryInfo &info)
+    {
+        return info.simple && info.kind == "select" && !info.aggregate.empty() && info.limit < 0 &&
+               (info.where.empty() || (info.where.size() == 1 && info.where[0].op == "="));
+    }
 
-    void admit(const std::string &query) override
+    std::string get(const std::string &key, unsigned long snapshot)
     {
-        // New queries go to short-term queue.
-        short_term.push_back(query);
+        auto it = views.find(key);
+        if (it == views.end() || it->second.version > snapshot)
+        {
+            misses++;
+            return "";
+        }
+        hits++;
+        it->second.last_used = ++clock;
+        return it->second.render();
+    }
+
+    // Install a view, evicting the least recently used one when full.
+    void install(const std::string &key, const std::string &table, AggregateView view)
+    {
+        if (views.size() >= max_views && !views.count(key))
+        {
+            auto coldest = std::min_element(views.begin(), views.end(), [](const auto &a, const auto &b)
+                                            { return a.second.last_used < b.second.last_used; });
+            std::string victim = coldest->first;
+            drop(victim, coldest->second.table);
+            views_evicted++;
+        }
+        view.table = table;
+        view.last_used = ++clock;
+        views[key] = std::move(view);
+        table_index[table].insert(key);
+    }
+
+    // Apply a commit group's row changes to every view on their tables.
+    void apply(const std::vector<RowChange> &changes)
+    {
+        for (const auto &change : changes)
+        {
+            auto indexed = table_index.find(change.table);
+            if (indexed == table_index.end())
+                continue;
+            std::vector<std::string> stale;
+            for (const auto &key : indexed->second)
+            {
+                if (views[key].apply(change))
+                    deltas_applied++;
+                else
+                    stale.push_back(key);
+            }
+            for (const auto &key : stale)
+            {
+                drop(key, change.table);
+                views_dropped++;
+            }
+        }
+    }
+
+    void stats()
+    {
+        std::cout << "Aggregate Views: " << views.size() << " (hits " << hits << ", misses " << misses
+                  << ", deltas applied " << deltas_applied << ", dropped " << views_dropped << ", evicted " << views_evicted << ")\n";
+    }
+};
+
+// Memory Pressure Monitoring
+//
+// Linux PSI reports, per cgroup v2 group in memory.pressure, the share of
+// wall time in which some task stalled on memory (reclaim, refaults,
+// swap-in), as 10, 60 and 300 second averages. The monitor registers a
+// PSI trigger on the process's group, or on the system-wide
+// /proc/pressure/memory if the group has none, so poll() wakes as soon as
+// stalls exceed trigger_stall_us in a trigger_window_us window. It also
+// wakes every poll_ms without an event, so falling pressure is noticed.
+// Each wake-up passes the current "some" avg10 to the callback. Without
+// PSI (older kernels, other platforms) it does nothing.
+class MemoryPressureMonitor
+{
+    std::function<void(double)> on_sample;
+    std::string path;
+    std::thread worker;
+#ifdef __linux__
+    int trigger = -1;
+    int wake[2] = {-1, -1}; // Written to on shutdown to interrupt poll().
+
+    void run()
+    {
+        pollfd fds[2] = {{trigger, POLLPRI, 0}, {wake[0], POLLIN, 0}};
+        while (true)
+        {
+            // poll() skips the trigger slot while it is -1.
+            int ready = poll(fds, 2, poll_ms);
+            if (ready < 0 && errno != EINTR)
+                return;
+            if (fds[1].revents & POLLIN)
+                return;
+            if (fds[0].revents & POLLERR)
+                return; // The group went away.
+            double avg10;
+            if (read_some_avg10(path, avg10))
+                on_sample(avg10);
+        }
+    }
+#endif
+
+    // Directory of the process's cgroup v2 group, or "" if there is none.
+    // Hybrid hierarchies mount v2 under /sys/fs/cgroup/unified.
+    static std::string cgroup_dir()
+    {
+        std::ifstream self("/proc/self/cgroup");
+        std::string line;
+        while (std::getline(self, line))
+        {
+            if (line.compare(0, 3, "0::") != 0)
+                continue;
+            std::string group = line.substr(3);
+            if (group == "/")
+                group.clear();
+            for (const char *root : {"/sys/fs/cgroup", "/sys/fs/cgroup/unified"})
+            {
+                if (std::ifstream(root + group + "/cgroup.controllers"))
+                    return root + group;
+            }
+        }
+        return "";
+    }
+
+public:
+    static const int trigger_stall_us = 150000;
+    static const int trigger_window_us = 2000000; // Unprivileged triggers need a multiple of 2 s.
+    static const int poll_ms = 2000;
+
+    explicit MemoryPressureMonitor(std::function<void(double)> callback) : on_sample(std::move(callback))
+    {
+        std::string dir = cgroup_dir();
+        path = !dir.empty() && std::ifstream(dir + "/memory.pressure") ? dir + "/memory.pressure" : "/proc/pressure/memory";
+        double avg10;
+        if (!read_some_avg10(path, avg10))
+        {
+            path.clear();
+            return;
+        }
+#ifdef __linux__
+        if (pipe(wake) != 0)
+            return;
+        trigger = open(path.c_str(), O_RDWR | O_NONBLOCK);
+        std::string spec = "some " + std::to_string(trigger_stall_us) + " " + std::to_string(trigger_window_us);
+        if (trigger >= 0 && write(trigger, spec.c_str(), spec.size() + 1) < 0)
+        {
+            // No trigger: fall back to sampling every poll_ms.
+            close(trigger);
+            trigger = -1;
+        }
+        worker = std::thread(&MemoryPressureMonitor::run, this);
+#endif
+    }
+
+    ~MemoryPressureMonitor()
+    {
+#ifdef __linux__
+        if (worker.joinable())
+        {
+            char stop = 0;
+            if (write(wake[1], &stop, 1) < 0)
+                std::cerr << "Could not stop the memory pressure monitor.\n";
+            worker.join();
+        }
+        for (int fd : {trigger, wake[0], wake[1]})
+        {
+            if (fd >= 0)
+                close(fd);
+        }
+#endif
+    }
+
+    bool active() const { return worker.joinable(); }
+    const std::string &source() const { return path; }
+
+    // Parse "some avg10=<percent> ..." from a PSI file.
+    static bool read_some_avg10(const std::string &file, double &avg10)
+    {
+        std::ifstream in(file);
+        std::string kind, field;
+        if (!(in >> kind >> field) || kind != "some" || field.compare(0, 6, "avg10=") != 0)
+            return false;
+        return parse_number(field.substr(6), avg10);
+    }
+
+    // The memory.max limit of the process's cgroup v2 group and its
+    // ancestors, whichever is lowest, in bytes; -1 if there is none.
+    static long long memory_limit()
+    {
+        std::string dir = cgroup_dir();
+        long long limit = -1;
+        while (dir.size() > std::string("/sys/fs/cgroup").size())
+        {
+            std::ifstream max(dir + "/memory.max");
+            std::string value;
+            if (max >> value && value != "max")
+            {
+                long long bytes = std::atoll(value.c_str());
+                if (bytes > 0 && (limit < 0 || bytes < limit))
+                    limit = bytes;
+            }
+            dir = dir.substr(0, dir.rfind('/'));
+        }
+        return limit;
+    }
+};
+
+// Database System Simulation with Extended Cache Strategies
+
+class DatabaseSystem
+{
+    QueryParser parser;
+    QueryOptimizer optimizer;
+    ExecutionEngine engine;
+    TransactionManager tx_manager;
+    LockManager lock_manager;
+    CacheStrategy *cache_strategy;
+    AggregateCache aggregates;
+    std::unique_ptr<ShadowSelector> shadow; // Set while the policy is chosen automatically.
+    S3FIFOCache intermediates; // Recycled subquery and derived-table results, by subplan hash.
+    std::shared_mutex cache_mutex; // Guards cache_strategy, shadow, aggregates and intermediates.
+    std::thread maintainer;    // Background eviction, see maintain().
+    std::mutex maintenance_mutex; // Guards maintenance_due and stop_maintenance.
+    std::condition_variable maintenance_wanted;
+    bool maintenance_due;
+    bool stop_maintenance;
+    int base_capacity;       // Capacity without memory pressure; guarded by cache_mutex.
+    double memory_pressure;  // Last PSI "some" avg10 seen, in percent; guarded by cache_mutex.
+    std::unique_ptr<MemoryPressureMonitor> pressure_monitor;
+    Transaction session_tx; // Explicit transaction opened by BEGIN.
+    bool in_transaction;
+
+    // The default capacity: with a cgroup memory.max, a byte budget of
+    // cache_memory_share of it, in ByteWeigher::unit steps; without one, 5
+    // entries.
+    static int default_capacity()
+    {
+        long long limit = MemoryPressureMonitor::memory_limit();
+        if (limit <= 0)
+            return 5;
+        return (int)std::max(5LL, std::min<long long>(INT_MAX, (long long)(limit * cache_memory_share) / ByteWeigher::unit));
+    }
+
+    // The default policy for a capacity. Under a memory limit it is the
+    // byte-weighted S3-FIFO, which charges every entry its measured
+    // size_bytes() against capacity * ByteWeigher::unit bytes, so results of
+    // any size stay within the budget. The entry count is capped at capacity
+    // too, which binds only while entries average under one unit and so
+    // errs on the side of using less memory. Otherwise the legacy LIRS
+    // class is the default, up to legacy_policy_limit entries; it walks its
+    // whole recency list on every access, so S3-FIFO takes over above that.
+    static const char *default_policy(int capacity)
+    {
+        if (MemoryPressureMonitor::memory_limit() > 0)
+            return "size+s3fifo";
+        return capacity > legacy_policy_limit ? "s3-fifo" : "lirs";
+    }
+
+    static CacheStrategy *default_strategy(int capacity)
+    {
+        std::string label;
+        return make_strategy(default_policy(capacity), capacity, label);
+    }
+
+    // Capacity for the current pressure: shed_per_point of base_capacity
+    // for each point of avg10, up to max_shed.
+    int pressure_capacity() const
+    {
+        double shed = std::min(max_shed, shed_per_point * memory_pressure);
+        return std::max(1, (int)std::lround(base_capacity * (1 - shed)));
+    }
+
+public:
+    static constexpr double cache_memory_share = 0.25;
+    static const int legacy_policy_limit = 1024;
+    double shed_per_point = 0.05;
+    double max_shed = 0.75;
+    double regrow_step = 0.1; // Largest share of base_capacity regained per pressure sample.
+
+    DatabaseSystem() : cache_strategy(default_strategy(default_capacity())), intermediates(16), maintenance_due(false), stop_maintenance(false),
+                       base_capacity(cache_strategy->capacity), memory_pressure(0), in_transaction(false)
+    {
+        // Committed writes end the validity of cached results on their tables.
+        // Aggregate views absorb the committed row changes instead.
+        tx_manager.on_commit = [this](const std::map<std::string, unsigned long> &written, const std::vector<RowChange> &changes)
+        {
+            std::lock_guard<std::shared_mutex> guard(cache_mutex);
+            cache_strategy->end_versions(written, tx_manager.oldest_snapshot());
+            intermediates.end_versions(written, tx_manager.oldest_snapshot());
+            aggregates.apply(changes);
+        };
+        maintainer = std::thread(&DatabaseSystem::maintain, this);
+        pressure_monitor.reset(new MemoryPressureMonitor([this](double avg10)
+                                                         { relieve_pressure(avg10); }));
+    }
+
+    ~DatabaseSystem()
+    {
+        pressure_monitor.reset();
+        if (in_transaction)
+            finish_transaction(session_tx, false);
+        {
+            std::lock_guard<std::mutex> guard(maintenance_mutex);
+            stop_maintenance = true;
+        }
+        maintenance_wanted.notify_one();
+        maintainer.join();
+        delete cache_strategy;
+    }
+
+    std::string trim(const std::string &str)
+    {
+        size_t first = str.find_first_not_of(' ');
+        size_t last = str.find_last_not_of(' ');
+        if (first == std::string::npos || last == std::string::npos)
+            return "";
+        return str.substr(first, (last - first + 1));
+    }
+
+    void print_raw_input_info(const std::string &input)
+    {
+        std::cout << "DEBUG: Raw input: '" << input << "'\n";
+        std::cout << "DEBUG: Input length: " << input.length() << "\n";
+
+        // Display the ASCII values of each character in the input string
+        std::cout << "DEBUG: ASCII values of input characters: ";
+        for (char c : input)
+        {
+            std::cout << static_cast<int>(c) << " ";
+        }
+        std::cout << "\n";
+    }
+
+    void set_cache_strategy(const std::string &strategy)
+    {
+        std::lock_guard<std::shared_mutex> guard(cache_mutex);
+        std::string strat = strategy;
+
+        // Print raw input before any transformation for detailed inspection
+        print_raw_input_info(strat);
+
+        // Trim leading/trailing spaces and convert to lowercase for case-insensitive comparison
+        strat = trim(strat);
+        std::transform(strat.begin(), strat.end(), strat.begin(), ::tolower);
+
+        std::cout << "DEBUG: Processed strategy (after trim and lowercase): '" << strat << "'\n";
+
+        shadow.reset();
+        // "auto" shadows the candidate policies and lets the best one run live.
+        // The legacy LIRS and TinyFLU classes are both plain LRU, so only one
+        // of them races; S3-FIFO and W-TinyLFU are the distinct challengers.
+        bool automatic = strat == "auto";
+        int capacity = cache_strategy->capacity; // Kept across switches, see resize_cache().
+        std::string label;
+        CacheStrategy *replacement = make_strategy(automatic ? default_policy(capacity) : strat, capacity, label);
+        if (!replacement)
+        {
+            replace_strategy(make_strategy(default_policy(capacity), capacity, label));
+            std::cout << "Invalid caching strategy selected. Defaulting to " << label << ".\n";
+            return;
+        }
+        replace_strategy(replacement);
+        if (automatic)
+        {
+            shadow.reset(new ShadowSelector({"lirs", "s3-fifo", "w-tinylfu"}, default_policy(capacity), capacity));
+            std::cout << "Automatic policy selection enabled, starting with " << label << ".\n";
+        }
+        else
+        {
+            std::cout << "Caching strategy set to " << label << ".\n";
+        }
+    }
+
+    // Background eviction. Woken once the cache fills past its high
+    // watermark, the maintenance thread evicts batches of trim_batch
+    // entries down to the low watermark, taking cache_mutex only for each
+    // batch so queries keep running between them. Inserts then rarely find
+    // the cache at capacity and pay for an eviction themselves.
+    int trim_batch = 16;
+
+    void maintain()
+    {
+        std::unique_lock<std::mutex> lock(maintenance_mutex);
+        while (true)
+        {
+            maintenance_wanted.wait(lock, [this]()
+                                    { return stop_maintenance || maintenance_due; });
+            if (stop_maintenance)
+                return;
+            maintenance_due = false;
+            lock.unlock();
+            bool above = true;
+            while (above)
+            {
+                {
+                    std::lock_guard<std::shared_mutex> guard(cache_mutex);
+                    above = cache_strategy->trim(trim_batch, cache_strategy->low_watermark);
+                }
+                std::this_thread::yield();
+            }
+            // Give pool regions the evictions emptied back to the system.
+            HugePageArena::instance().release_free();
+            lock.lock();
+        }
+    }
+
+    // Wake the maintenance thread if the cache is above its high watermark.
+    // Requires cache_mutex.
+    void request_maintenance()
+    {
+        if (!cache_strategy->above_high_watermark())
+            return;
+        {
+            std::lock_guard<std::mutex> guard(maintenance_mutex);
+            maintenance_due = true;
+        }
+        maintenance_wanted.notify_one();
+    }
+
+    // Change the cache capacity without flushing it. Growing takes effect at
+    // once; after a shrink the maintenance thread evicts the surplus.
+    // The requested capacity becomes the base that memory pressure sheds
+    // from.
+    void resize_cache(int capacity)
+    {
+        std::lock_guard<std::shared_mutex> guard(cache_mutex);
+        base_capacity = std::max(1, capacity);
+        cache_strategy->resize(pressure_capacity());
+        if (shadow)
+            shadow->resize(cache_strategy->capacity);
+        std::cout << "Cache capacity set to " << cache_strategy->capacity << " (" << cache_strategy->cache.size()
+                  << " entries cached).\n";
+        request_maintenance();
+    }
+
+    // Follow a memory pressure sample. Rising pressure sheds capacity at
+    // once, and the maintenance thread evicts down to it. Falling pressure
+    // regrows by at most regrow_step of the base per sample, so the cache
+    // does not grow straight back into the stall that shrank it.
+    void relieve_pressure(double avg10)
+    {
+        std::lock_guard<std::shared_mutex> guard(cache_mutex);
+        memory_pressure = avg10;
+        int current = cache_strategy->capacity;
+        int target = pressure_capacity();
+        if (target > current)
+            target = std::min(target, current + std::max(1, (int)std::lround(regrow_step * base_capacity)));
+        if (target == current)
+            return;
+        cache_strategy->resize(target);
+        if (shadow)
+            shadow->resize(target);
+        request_maintenance();
+    }
+
+    // SET GLOBAL cache_size = <entries> and SET GLOBAL cache_huge_pages =
+    // off | transparent | hugetlbfs. Returns an empty string for any other
+    // statement.
+    std::string set_variable(const std::string &query)
+    {
+        std::vector<std::string> tokens = parser.tokenize(query);
+        for (auto &token : tokens)
+            std::transform(token.begin(), token.end(), token.begin(), ::tolower);
+        if (tokens.size() < 4 || tokens[1] != "global")
+            return "";
+        if (tokens[2] == "cache_huge_pages")
+        {
+            std::string mode = tokens.back();
+            mode.erase(std::remove(mode.begin(), mode.end(), '\''), mode.end());
+            if (mode == "off")
+                HugePageArena::instance().set_mode(HugePageArena::Off);
+            else if (mode == "transparent")
+                HugePageArena::instance().set_mode(HugePageArena::Transparent);
+            else if (mode == "hugetlbfs")
+                HugePageArena::instance().set_mode(HugePageArena::Hugetlbfs);
+            else
+                return "Invalid value for cache_huge_pages";
+            return "OK";
+        }
+        if (tokens[2] != "cache_size")
+            return "";
+        int capacity = std::atoi(tokens.back().c_str());
+        if (capacity <= 0)
+            return "Invalid value for cache_size";
+        resize_cache(capacity);
+        return "OK";
+    }
+
+    // Swap in a new strategy that carries over the current one's entries.
+    // Requires cache_mutex.
+    void replace_strategy(CacheStrategy *replacement)
+    {
+        replacement->adopt(*cache_strategy);
+        delete cache_strategy;
+        cache_strategy = replacement;
+        request_maintenance();
+        if (!replacement->unmigrated.empty())
+            std::cout << "Migrating " << replacement->unmigrated.size() << " cached entries to the new policy.\n";
+    }
+
+    // Run a plan through the engine under the lock manager. Tables are locked
+    // in sorted order for the duration of the statement, shared for reads and
+    // exclusive for everything else. Intermediate tables are private to the
+    // statement and are not locked. The result text is empty if a lock wait
+    // timed out.
+    ExecutionResult execute_plan(const std::string &plan, const QueryInfo &info, unsigned long tx_id)
+    {
+        LockMode mode = info.kind == "select" ? LockMode::Shared : LockMode::Exclusive;
+        std::vector<std::string> tables;
+        for (const auto &table : info.tables)
+        {
+            if (!engine.intermediate(table))
+                tables.push_back(table);
+        }
+        size_t locked = 0;
+        while (locked < tables.size() && lock_manager.acquire(tables[locked], mode))
+            locked++;
+
+        ExecutionResult result;
+        result.write_epoch = tx_manager.write_epoch(info.tables);
+        if (locked == tables.size())
+        {
+            auto start = std::chrono::steady_clock::now();
+            result = engine.execute(plan, info, tx_id);
+            result.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+        while (locked > 0)
+            lock_manager.release(tables[--locked], mode);
+        return result;
+    }
+
+    void finish_transaction(Transaction &tx, bool commit)
+    {
+        if (commit)
+        {
+            tx_manager.commit(tx);
+            engine.commit(tx.id);
+        }
+        else
+        {
+            engine.rollback(tx.id);
+            tx_manager.rollback(tx);
+        }
+    }
+
+    // Feed a read to the shadow caches and switch the live policy if they
+    // have settled on a better one. Requires cache_mutex.
+    void follow_shadow(const std::string &key)
+    {
+        shadow->record(key);
+        std::string next;
+        if (!shadow->recommendation(next))
+            return;
+        std::string label;
+        CacheStrategy *replacement = make_strategy(next, cache_strategy->capacity, label);
+        if (!replacement)
+            return;
+        replace_strategy(replacement);
+        std::cout << "Shadow caches favour " << label << "; switched the live policy.\n";
+    }
+
+    // Answer an exact hit without the exclusive lock, when the live policy
+    // takes hits under a shared one. Aggregates and subsumed reads are left
+    // to probe_cache(), as is a pending shadow recommendation. Returns an
+    // empty string if the read needs probe_cache().
+    // Requires cache_mutex, shared or exclusive.
+    std::string probe_shared(const std::string &key, const QueryInfo &info, unsigned long snapshot)
+    {
+        if (!cache_strategy->shared_hits() || AggregateCache::eligible(info))
+            return "";
+        std::string result = cache_strategy->get_shared(key, snapshot);
+        if (!result.empty() && shadow)
+            shadow->record(key);
+        return result;
+    }
+
+    // Look a read up in the shared caches at snapshot. Plain SELECTs may be
+    // answered from another query's cached rows by projecting the requested
+    // columns and, for ranges, re-applying their own predicates.
+    // Requires cache_mutex.
+    std::string probe_cache(const std::string &key, const QueryInfo &info, unsigned long snapshot)
+    {
+        if (shadow)
+            follow_shadow(key);
+        std::string result;
+        std::string group;
+        std::string filter_column;
+        Interval range;
+        if (AggregateCache::eligible(info))
+            result = aggregates.get(key, snapshot);
+        if (!result.empty())
+            return result;
+        if (!reuse_group(info, group, range, filter_column))
+            return cache_strategy->get(key, snapshot);
+
+        const CacheEntry *entry = cache_strategy->get_reusable(key, group, range, filter_column, info.columns, snapshot);
+        if (!entry)
+            return "";
+        auto exact = cache_strategy->cache.find(key);
+        if (exact != cache_strategy->cache.end() && &exact->second == entry)
+            return entry->result;
+
+        const ResultSet &wider = *entry->rows;
+        bool filter = !range.contains(entry->range);
+        auto position = [&wider](const std::string &column)
+        {
+            return static_cast<size_t>(std::find(wider.columns.begin(), wider.columns.end(), column) - wider.columns.begin());
+        };
+        size_t filter_position = filter ? position(filter_column) : 0;
+        std::vector<size_t> projection;
+        ResultSet narrower;
+        narrower.columns = info.columns.empty() ? wider.columns : info.columns;
+        for (const auto &column : narrower.columns)
+        {
+            projection.push_back(position(column));
+        }
+        for (const auto &row : wider.rows)
+        {
+            // The engine's own comparison, so cut rows match a fresh run.
+            if (filter && !std::all_of(info.where.begin(), info.where.end(), [&](const Predicate &predicate)
+                                       { return satisfies(row[filter_position], predicate); }))
+                continue;
+            std::vector<std::string> projected;
+            for (size_t index : projection)
+            {
+                projected.push_back(row[index]);
+            }
+            narrower.rows.push_back(projected);
+        }
+        return ExecutionEngine::render(optimizer.optimize(parser.parse(key)), narrower);
+    }
+
+    // Cache a read computed at snapshot. Entries are valid from the last
+    // commit that wrote their tables; if a commit newer than the snapshot has
+    // already landed, the result is stale for new readers and is not cached.
+    // Aggregates the row store computed become incrementally maintained views.
+    void cache_result(const std::string &key, const std::string &plan, const QueryInfo &info, const ExecutionResult &executed, unsigned long snapshot)
+    {
+        bool aggregate = AggregateCache::eligible(info) && executed.structured;
+        AggregateView view;
+        if (aggregate)
+        {
+            view.plan = plan;
+            view.function = info.aggregate;
+            view.header = info.aggregate + "(" + info.aggregate_column + ")";
+            if (info.aggregate_column != "*")
+                view.value_column = engine.column_index(info.tables[0], info.aggregate_column);
+            if (!info.where.empty())
+            {
+                view.filter_column = engine.column_index(info.tables[0], info.where[0].column);
+                view.filter_value = info.where[0].value;
+            }
+            view.state = executed.aggregate;
+        }
+
+        std::lock_guard<std::shared_mutex> guard(cache_mutex);
+        unsigned long version = tx_manager.last_write_on(info.tables);
+        if (version > snapshot || !tx_manager.clean_since(info.tables, executed.write_epoch))
+            return;
+        if (aggregate)
+        {
+            view.version = version;
+            aggregates.install(key, info.tables[0], std::move(view));
+            return;
+        }
+        CacheEntry entry;
+        entry.result = executed.text;
+        entry.tables = info.tables;
+        entry.valid_from = version;
+        entry.cost_ms = executed.elapsed_ms;
+        std::string filter_column;
+        if (executed.structured && reuse_group(info, entry.reuse_group, entry.range, filter_column) &&
+            (filter_column.empty() || numeric_column(executed.rows, filter_column)))
+        {
+            entry.rows = std::make_shared<ResultSet>(executed.rows);
+            entry.all_columns = info.columns.empty();
+        }
+        else
+        {
+            entry.reuse_group.clear();
+        }
+        cache_strategy->put(key, std::move(entry));
+        request_maintenance();
     }
 
-    void update(const std::string &query) override
+    // Run one statement inside tx. Reads are served from the shared cache
+    // when an entry is valid for the transaction's snapshot. Reads of tables
+    // the transaction has written go through its private overlay instead, so
+    // it sees its own changes while other sessions keep the shared entries.
+    std::string run_statement(const std::string &query, const QueryInfo &info, Transaction &tx)
     {
-        // Promote queries across queues.
-        auto it = std::find(short_term.begin(), short_term.end(), query);
-        if (it != short_term.end())
+        std::string key = parser.fingerprint(query);
+        std::string plan = optimizer.optimize(parser.parse(query));
+        bool is_read = info.kind == "select";
+        bool overlay_read = is_read && tx.overlay.covers(info.tables);
+
+        if (is_read && !overlay_read && info.simple && info.aggregate.empty() && info.limit >= 0)
+            return run_paginated(query, info, tx);
+        if (overlay_read)
         {
-            short_term.erase(it);
-            medium_term.push_back(query);
-            return;
+            std::string private_result = tx.overlay.get(key);
+            if (!private_result.empty())
+            {
+                std::cout << "Transaction-private cache hit!\n";
+                return private_result;
+            }
+            std::cout << "Transaction-private cache miss! Executing query...\n";
         }
-        it = std::find(medium_term.begin(), medium_term.end(), query);
-        if (it != medium_term.end())
+        else if (is_read)
         {
-            medium_term.erase(it);
-            long_term.push_back(query);
-            return;
+            std::string cached_result;
+            {
+                std::shared_lock<std::shared_mutex> guard(cache_mutex);
+                cached_result = probe_shared(key, info, tx.snapshot);
+            }
+            if (cached_result.empty())
+            {
+                std::lock_guard<std::shared_mutex> guard(cache_mutex);
+                cached_result = probe_cache(key, info, tx.snapshot);
+            }
+            if (!cached_result.empty())
+            {
+                std::cout << "Cache hit!\n";
+                return cached_result;
+            }
+            std::cout << "Cache miss! Executing query...\n";
         }
-        it = std::find(long_term.begin(), long_term.end(), query);
-        if (it != long_term.end())
+        else
         {
-            long_term.erase(it);
-            long_term.push_back(query); // Refresh position.
+            std::cout << "Executing statement...\n";
         }
-    }
 
-    void evict() override
-    {
-        std::string victim;
-        if (!short_term.empty())
+        if (!is_read)
+            tx_manager.writing(tx, info.tables);
+        ExecutionResult executed = is_read ? execute_recycled(query, info, tx) : execute_plan(plan, info, tx.id);
+        if (executed.text.empty())
+            return "";
+        if (!is_read)
         {
-            victim = short_term.front();
-            short_term.pop_front();
+            // Writes the row store could not run leave the affected rows unknown.
+            if (!executed.structured)
+            {
+                for (const auto &table : info.tables)
+                {
+                    executed.changes.push_back(RowChange{table, {}, {}});
+                }
+            }
+            tx.overlay.record_write(info.tables, executed.changes);
         }
-        else if (!medium_term.empty())
+        else if (overlay_read)
         {
-            victim = medium_term.front();
-            medium_term.pop_front();
+            tx.overlay.put(key, executed.text, info.tables);
         }
-        else if (!long_term.empty())
+        else
         {
-            victim = long_term.front();
-            long_term.pop_front();
+            cache_result(key, plan, info, executed, tx.snapshot);
         }
-        else if (!cache.empty())
+        return executed.text;
+    }
+
+    // Produce the rows of a subplan, recycling them from the intermediate
+    // result cache when a version valid for the snapshot is there. Subplans
+    // over tables the transaction has written are executed privately.
+    // Returns nullptr if the subplan cannot be materialized.
+    std::shared_ptr<const ResultSet> materialize(const std::string &text, Transaction &tx)
+    {
+        std::ostringstream key;
+        key << "subplan#" << std::hex << std::hash<std::string>{}(parser.fingerprint(text));
+        QueryInfo info = parser.analyze(text);
+        bool shared = !tx.overlay.covers(info.tables);
+        if (shared)
         {
-            victim = cache.begin()->first;
+            std::lock_guard<std::shared_mutex> guard(cache_mutex);
+            std::shared_ptr<const ResultSet> rows = intermediates.get_rows(key.str(), tx.snapshot);
+            if (rows)
+            {
+                std::cout << "Recycled intermediate " << key.str() << ".\n";
+                return rows;
+            }
         }
-        if (!victim.empty())
+
+        auto start = std::chrono::steady_clock::now();
+        ExecutionResult executed = execute_recycled(text, info, tx);
+        double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (executed.text.empty() || !executed.structured)
+            return nullptr;
+        auto rows = std::make_shared<const ResultSet>(executed.rows);
+        if (shared)
         {
-            cache.erase(victim);
-            std::cout << "S3-FIFO Evicted: " << victim << "\n";
+            std::lock_guard<std::shared_mutex> guard(cache_mutex);
+            unsigned long version = tx_manager.last_write_on(info.tables);
+            if (version <= tx.snapshot && tx_manager.clean_since(info.tables, executed.write_epoch))
+            {
+                CacheEntry entry;
+                entry.tables = info.tables;
+                entry.valid_from = version;
+                entry.cost_ms = elapsed_ms;
+                entry.rows = rows;
+                intermediates.put(key.str(), std::move(entry));
+            }
         }
+        return rows;
     }
-};
 
-// Database System Simulation with Extended Cache Strategies
+    // Execute a read, first materializing the subplans the optimizer marks
+    // as reusable and rewriting the query to consume them: IN subqueries and
+    // scalar subqueries become literals and derived tables become registered
+    // intermediate tables. Falls back to the plain plan if any subplan cannot
+    // be materialized. Intermediate tables live only for the statement, and
+    // the result is rendered against the original plan so it can be cached
+    // under the original statement.
+    ExecutionResult execute_recycled(const std::string &query, const QueryInfo &info, Transaction &tx)
+    {
+        std::vector<std::string> tokens = parser.tokenize(query);
+        std::vector<Subplan> subplans = optimizer.find_subplans(tokens);
+        std::string plan = optimizer.optimize(parser.parse(query));
+        if (subplans.empty())
+            return execute_plan(plan, info, tx.id);
+        auto started = std::chrono::steady_clock::now();
+        unsigned long write_epoch = tx_manager.write_epoch(info.tables);
+        std::vector<std::string> registered;
+        auto drop_registered = [&]()
+        {
+            for (const auto &name : registered)
+            {
+                engine.drop_table(name);
+            }
+        };
 
-class DatabaseSystem
-{
-    QueryParser parser;
-    QueryOptimizer optimizer;
-    ExecutionEngine engine;
-    TransactionManager tx_manager;
-    LockManager lock_manager;
-    CacheStrategy *cache_strategy;
+        auto quote = [](const std::string &value)
+        {
+            std::string quoted = "'";
+            for (char c : value)
+            {
+                quoted += c == '\'' ? "''" : std::string(1, c);
+            }
+            return quoted + "'";
+        };
+        std::string rewritten;
+        size_t next = 0;
+        for (const auto &subplan : subplans)
+        {
+            for (; next < subplan.begin; next++)
+            {
+                rewritten += tokens[next] + " ";
+            }
+            next = subplan.end;
+            std::shared_ptr<const ResultSet> rows = materialize(subplan.text, tx);
+            if (!rows || (subplan.kind != "derived" && rows->columns.size() != 1) ||
+                (subplan.kind == "scalar" && rows->rows.size() != 1))
+            {
+                drop_registered();
+                return execute_plan(plan, info, tx.id);
+            }
 
-public:
-    DatabaseSystem() : cache_strategy(new LIRSCache(5)) {}
+            if (subplan.kind == "derived")
+            {
+                registered.push_back(engine.register_table(*rows));
+                rewritten += registered.back() + " ";
+            }
+            else if (subplan.kind == "scalar")
+            {
+                rewritten += quote(rows->rows[0][0]) + " ";
+            }
+            else
+            {
+                std::string list;
+                for (const auto &row : rows->rows)
+                {
+                    list += (list.empty() ? "" : " , ") + quote(row[0]);
+                }
+                rewritten += "( " + (list.empty() ? std::string("NULL") : list) + " ) ";
+            }
+        }
+        for (; next < tokens.size(); next++)
+        {
+            rewritten += tokens[next] + " ";
+        }
+        rewritten.pop_back();
 
-    ~DatabaseSystem()
-    {
-        delete cache_strategy;
+        std::cout << "Rewritten to consume intermediates: " << rewritten << "\n";
+        ExecutionResult result = execute_recycled(rewritten, parser.analyze(rewritten), tx);
+        drop_registered();
+        result.write_epoch = write_epoch;
+        if (!result.text.empty())
+            result.text = result.structured ? ExecutionEngine::render(plan, result.rows) : "Result for " + plan;
+        // Charge the rewritten query with the subplans it consumed, so its
+        // cache cost reflects what a hit actually avoids.
+        result.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+        return result;
     }
 
-    std::string trim(const std::string &str)
+    // Paginated reads share one cached prefix of their base query's rows. A
+    // page inside the prefix is a slice of it; a page past it extends the
+    // prefix with one execution that fetches the missing tail, read ahead to
+    // twice the requested end so sequential paging rarely executes again.
+    std::string run_paginated(const std::string &query, const QueryInfo &info, Transaction &tx)
     {
-        size_t first = str.find_first_not_of(' ');
-        size_t last = str.find_last_not_of(' ');
-        if (first == std::string::npos || last == std::string::npos)
-            return "";
-        return str.substr(first, (last - first + 1));
+        std::string base = parser.base_fingerprint(query);
+        std::string prefix_key = "prefix|" + base;
+        std::string plan = optimizer.optimize(parser.parse(query));
+        size_t end = info.offset + info.limit;
+        std::shared_ptr<const ResultSet> prefix;
+        unsigned long prefix_version = 0;
+        bool hit = false;
+        {
+            std::lock_guard<std::shared_mutex> guard(cache_mutex);
+            const CacheEntry *entry = cache_strategy->get_prefix(prefix_key, end, tx.snapshot);
+            hit = entry != nullptr;
+            if (!hit)
+                entry = cache_strategy->peek(prefix_key, tx.snapshot);
+            if (entry)
+            {
+                prefix = entry->rows;
+                prefix_version = entry->valid_from;
+            }
+        }
+
+        ResultSet rows;
+        if (hit)
+        {
+            std::cout << "Cache hit! Serving rows " << info.offset << ".." << end << " from a cached prefix.\n";
+            rows = *prefix;
+        }
+        else
+        {
+            ExecutionResult executed;
+            size_t want;
+            while (true)
+            {
+                size_t have = prefix ? prefix->rows.size() : 0;
+                want = 2 * std::max(end, have) - have;
+                std::cout << "Cache miss! Fetching rows " << have << ".." << have + want << "...\n";
+                QueryInfo tail = info;
+                tail.offset = have;
+                tail.limit = want;
+                std::string tail_plan = optimizer.optimize(parser.parse(base + " limit " + std::to_string(want) + " offset " + std::to_string(have)));
+                executed = execute_plan(tail_plan, tail, tx.id);
+                if (executed.text.empty() || !executed.structured)
+                    return executed.text;
+                // The tail ran on the tables as they are now. It only
+                // continues the prefix if nothing was committed to them since
+                // the prefix was computed; otherwise fetch from the start.
+                if (!prefix || tx_manager.last_write_on(info.tables) == prefix_version)
+                    break;
+                prefix.reset();
+            }
+            if (prefix)
+                rows = *prefix;
+            else
+                rows.columns = executed.rows.columns;
+            rows.rows.insert(rows.rows.end(), executed.rows.rows.begin(), executed.rows.rows.end());
+            cache_prefix(prefix_key, info, rows, executed.rows.rows.size() < want, executed, tx.snapshot);
+        }
+
+        ResultSet page;
+        page.columns = rows.columns;
+        for (size_t i = info.offset; i < end && i < rows.rows.size(); i++)
+        {
+            page.rows.push_back(rows.rows[i]);
+        }
+        return ExecutionEngine::render(plan, page);
     }
 
-    void print_raw_input_info(const std::string &input)
+    // Store or extend a pagination prefix computed at snapshot; tail is the
+    // execution that fetched its newest rows.
+    void cache_prefix(const std::string &prefix_key, const QueryInfo &info, const ResultSet &rows, bool complete, const ExecutionResult &tail, unsigned long snapshot)
     {
-        std::cout << "DEBUG: Raw input: '" << input << "'\n";
-        std::cout << "DEBUG: Input length: " << input.length() << "\n";
-
-        // Display the ASCII values of each character in the input string
-        std::cout << "DEBUG: ASCII values of input characters: ";
-        for (char c : input)
+        std::lock_guard<std::shared_mutex> guard(cache_mutex);
+        unsigned long version = tx_manager.last_write_on(info.tables);
+        if (version > snapshot || !tx_manager.clean_since(info.tables, tail.write_epoch))
+            return;
+        double cost_ms = tail.elapsed_ms;
+        CacheEntry entry;
+        entry.tables = info.tables;
+        entry.valid_from = version;
+        entry.rows = std::make_shared<ResultSet>(rows);
+        entry.prefix_complete = complete;
+        entry.cost_ms = cost_ms;
+        auto existing = cache_strategy->cache.find(prefix_key);
+        if (existing != cache_strategy->cache.end() && existing->second.valid_to == ULONG_MAX)
         {
-            std::cout << static_cast<int>(c) << " ";
+            if (existing->second.valid_from != version || existing->second.rows->rows.size() >= rows.rows.size())
+                return;
+            // Re-admit the grown prefix so weights and admission see its size.
+            entry.cost_ms += existing->second.cost_ms;
+            cache_strategy->replace(prefix_key, std::move(entry));
         }
-        std::cout << "\n";
+        else
+        {
+            cache_strategy->put(prefix_key, std::move(entry));
+        }
+        request_maintenance();
     }
 
-    void set_cache_strategy(const std::string &strategy)
+    // Process the query and return the result. BEGIN/START TRANSACTION,
+    // COMMIT and ROLLBACK control the session transaction; any other
+    // statement outside of one runs in its own autocommit transaction.
+    std::string process_query(const std::string &query)
     {
-        delete cache_strategy; // Remove current strategy
+        QueryInfo info = parser.analyze(query);
+        if (info.kind == "set")
+        {
+            std::string result = set_variable(query);
+            if (!result.empty())
+                return result;
+        }
+        if (info.kind == "begin" || info.kind == "start")
+        {
+            if (in_transaction)
+                finish_transaction(session_tx, true);
+            session_tx = tx_manager.begin();
+            in_transaction = true;
+            return "OK";
+        }
+        if (info.kind == "commit" || info.kind == "rollback")
+        {
+            if (in_transaction)
+            {
+                finish_transaction(session_tx, info.kind == "commit");
+                in_transaction = false;
+            }
+            return "OK";
+        }
 
-        std::string strat = strategy;
+        Transaction autocommit_tx;
+        if (!in_transaction)
+            autocommit_tx = tx_manager.begin();
+        Transaction &tx = in_transaction ? session_tx : autocommit_tx;
 
-        // Print raw input before any transformation for detailed inspection
-        print_raw_input_info(strat);
+        std::string result = run_statement(query, info, tx);
+        if (!in_transaction)
+            finish_transaction(tx, !result.empty());
+        if (result.empty())
+            return "Lock wait timeout exceeded; try restarting transaction";
+        return result;
+    }
 
-        // Trim leading/trailing spaces and convert to lowercase for case-insensitive comparison
-        strat = trim(strat);
-        std::transform(strat.begin(), strat.end(), strat.begin(), ::tolower);
+    // Process a batch of independent queries and return their results in
+    // input order. All queries are normalized first and deduplicated by
+    // fingerprint, the cache is probed for the whole batch, exact hits under
+    // one shared lock and the rest under one exclusive lock, and only the
+    // distinct misses are sent to the engine, concurrently. The probes are
+    // not prefetched: the index tables are std::unordered_maps, which give
+    // no bucket address to prefetch without loading the bucket first.
+    // Reads share one snapshot; other statements, paginated reads and reads
+    // with recyclable subplans run one by one through process_query before
+    // the reads are probed.
+    std::vector<std::string> process_batch(const std::vector<std::string> &queries)
+    {
+        // Normalize and deduplicate.
+        std::vector<std::string> keys;
+        std::vector<QueryInfo> infos;
+        std::vector<size_t> slot_of(queries.size());
+        std::unordered_map<std::string, size_t> slots;
+        std::vector<std::string> ordered(queries.size());
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            QueryInfo info = parser.analyze(queries[i]);
+            bool paginated = info.simple && info.aggregate.empty() && info.limit >= 0;
+            bool recycled = !info.simple && !optimizer.find_subplans(parser.tokenize(queries[i])).empty();
+            if (info.kind != "select" || paginated || recycled)
+            {
+                ordered[i] = process_query(queries[i]);
+                slot_of[i] = SIZE_MAX;
+                continue;
+            }
+            std::string key = parser.fingerprint(queries[i]);
+            auto it = slots.find(key);
+            if (it == slots.end())
+            {
+                it = slots.emplace(key, keys.size()).first;
+                keys.push_back(key);
+                infos.push_back(info);
+            }
+            slot_of[i] = it->second;
+        }
 
-        std::cout << "DEBUG: Processed strategy (after trim and lowercase): '" << strat << "'\n";
+        Transaction autocommit_tx;
+        if (!in_transaction)
+            autocommit_tx = tx_manager.begin();
+        Transaction &tx = in_transaction ? session_tx : autocommit_tx;
 
-        // Modify comparison to accept both s3fifo and s3-fifo
-        if (strat == "lirs")
+        std::vector<std::string> results(keys.size());
+        std::vector<bool> private_slot(keys.size());
+        std::vector<size_t> misses;
         {
-            cache_strategy = new LIRSCache(5);
-            std::cout << "Caching strategy set to LIRS.\n";
+            std::shared_lock<std::shared_mutex> guard(cache_mutex);
+            for (size_t i = 0; i < keys.size(); i++)
+            {
+                private_slot[i] = tx.overlay.covers(infos[i].tables);
+                if (!private_slot[i])
+                    results[i] = probe_shared(keys[i], infos[i], tx.snapshot);
+            }
         }
-        else if (strat == "tinyflu")
+        if (std::find(results.begin(), results.end(), "") != results.end())
         {
-            cache_strategy = new TinyFLUCache(5);
-            std::cout << "Caching strategy set to TinyFLU.\n";
+            std::lock_guard<std::shared_mutex> guard(cache_mutex);
+            for (size_t i = 0; i < keys.size(); i++)
+            {
+                if (!results[i].empty())
+                    continue;
+                if (private_slot[i])
+                    results[i] = tx.overlay.get(keys[i]);
+                else
+                    results[i] = probe_cache(keys[i], infos[i], tx.snapshot);
+                if (results[i].empty())
+                    misses.push_back(i);
+            }
         }
-        else if (strat == "s3fifo" || strat == "s3-fifo") // Accept both formats
+        std::cout << "Batch of " << queries.size() << " queries: " << keys.size() << " distinct reads, "
+                  << misses.size() << " to execute.\n";
+
+        // Execute the distinct misses concurrently.
+        std::vector<std::string> plans;
+        std::vector<std::future<ExecutionResult>> pending;
+        for (size_t slot : misses)
         {
-            cache_strategy = new S3FIFOCache(5);
-            std::cout << "Caching strategy set to S3-FIFO.\n";
+            plans.push_back(optimizer.optimize(parser.parse(keys[slot])));
+            QueryInfo info = infos[slot];
+            std::string plan = plans.back();
+            unsigned long tx_id = tx.id;
+            pending.push_back(std::async(std::launch::async, [this, plan, info, tx_id]()
+                                         { return execute_plan(plan, info, tx_id); }));
         }
-        else
+        for (size_t i = 0; i < misses.size(); i++)
         {
-            std::cout << "Invalid caching strategy selected. Defaulting to LIRS.\n";
-            delete cache_strategy;
-            cache_strategy = new LIRSCache(5);
+            size_t slot = misses[i];
+            ExecutionResult executed = pending[i].get();
+            results[slot] = executed.text;
+            if (results[slot].empty())
+                results[slot] = "Lock wait timeout exceeded; try restarting transaction";
+            else if (private_slot[slot])
+                tx.overlay.put(keys[slot], results[slot], infos[slot].tables);
+            else
+                cache_result(keys[slot], plans[i], infos[slot], executed, tx.snapshot);
         }
-    }
-    // Process the query and return the result.
-    std::string process_query(const std::string &query)
-    {
-        std::string parsed_query = parser.parse(query);
-        std::string plan = optimizer.optimize(parsed_query);
+        if (!in_transaction)
+            finish_transaction(tx, true);
 
-        // Check cache first.
-        std::string cached_result = cache_strategy->get(query);
-        if (!cached_result.empty())
+        for (size_t i = 0; i < queries.size(); i++)
         {
-            std::cout << "Cache hit!\n";
-            return cached_result;
-        }
-        else
-        {
-            std::cout << "Cache miss! Executing query...\n";
-            lock_manager.acquire("table");
-            std::cout << "Lock acquired on table.\n";
-            tx_manager.begin();
-            std::string result = engine.execute(plan);
-            tx_manager.commit();
-            lock_manager.release("table");
-            cache_strategy->put(query, result);
-            return result;
+            if (slot_of[i] != SIZE_MAX)
+                ordered[i] = results[slot_of[i]];
         }
+        return ordered;
     }
 
     void show_cache_stats()
     {
+        tx_manager.group_commit_stats();
+        std::lock_guard<std::shared_mutex> guard(cache_mutex);
+        aggregates.stats();
+        if (shadow)
+            shadow->stats();
+        std::cout << "Intermediate Results: " << intermediates.cache.size() << " (hits " << intermediates.cache_hits
+                  << ", misses " << intermediates.cache_misses << ")\n";
+        HugePageArena::instance().stats();
+        if (pressure_monitor->active())
+            std::cout << "Memory Pressure: " << memory_pressure << "% (" << pressure_monitor->source() << "), capacity "
+                      << cache_strategy->capacity << " of " << base_capacity << "\n";
         cache_strategy->stats();
     }
 
@@ -421,6 +5960,7 @@ public:
             "SELECT name FROM customers WHERE city = 'New York'",
             "SELECT * FROM orders",
             "SELECT COUNT(*) FROM sales",
+            "SELECT COUNT(name) FROM customers",        // COUNT over a text column: 8, not 0
             "SELECT * FROM employees",                  // duplicate to test cache hit
             "SELECT * FROM orders WHERE order_id = 100" // duplicate
         };
@@ -435,18 +5975,292 @@ public:
         std::chrono::duration<double> duration = end - start;
         std::cout << "Benchmark completed in " << duration.count() << " seconds.\n";
     }
+
+    void run_batch_benchmark()
+    {
+        std::vector<std::string> queries = {
+            "SELECT * FROM employees",
+            "SELECT * FROM orders WHERE order_id = 100",
+            "SELECT name FROM customers WHERE city = 'New York'",
+            "SELECT * FROM orders",
+            "SELECT COUNT(*) FROM sales",
+            "select *   from employees;",                 // same fingerprint as the first query
+            "SELECT * FROM orders WHERE order_id = 100" // duplicate
+        };
+
+        std::cout << "Running batched benchmark...\n";
+        auto start = std::chrono::high_resolution_clock::now();
+        process_batch(queries);
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> duration = end - start;
+        std::cout << "Batched benchmark completed in " << duration.count() << " seconds.\n";
+    }
 };
 
+// Cache Policy Simulator
+//
+// Replays synthetic key traces directly against strategy objects, with
+// the cost-based admission filter off so only the policies differ:
+//   zipf  - skewed popularity (alpha 0.9) over 10x the cache size;
+//   loop  - a cyclic scan over 1.2x the cache size, which defeats LRU;
+//   mixed - the zipf trace interrupted by one-time scans, like OLAP
+//           reports running next to point lookups;
+//   shift - alternating zipf and loop phases, a quarter of the trace each,
+//           for policies that adapt to the workload.
+
+std::vector<int> make_trace(const std::string &kind, int capacity, int length)
+{
+    std::mt19937 rng(42);
+    int universe = capacity * 10;
+    std::vector<double> cdf(universe);
+    double total = 0;
+    for (int i = 0; i < universe; i++)
+    {
+        total += 1.0 / std::pow(i + 1, 0.9);
+        cdf[i] = total;
+    }
+    std::uniform_real_distribution<double> uniform(0, total);
+    auto zipf = [&]()
+    { return (int)(std::lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin()); };
+
+    std::vector<int> trace;
+    int next_scan_key = universe;
+    while ((int)trace.size() < length)
+    {
+        if (kind == "loop" || (kind == "shift" && trace.size() / (length / 4) % 2 == 1))
+        {
+            trace.push_back(trace.size() % (capacity * 6 / 5));
+        }
+        else if (kind == "mixed" && trace.size() % 1000 == 999)
+        {
+            for (int i = 0; i < capacity * 2; i++)
+            {
+                trace.push_back(next_scan_key++);
+            }
+        }
+        else
+        {
+            trace.push_back(zipf());
+        }
+    }
+    trace.resize(length);
+    return trace;
+}
+
+double simulate(CacheStrategy &cache, const std::vector<int> &trace)
+{
+    cache.verbose = false;
+    cache.admission_ratio = 0;
+    for (int key : trace)
+    {
+        std::string query = "q" + std::to_string(key);
+        if (cache.get(query).empty())
+        {
+            CacheEntry entry;
+            entry.result = "r";
+            entry.cost_ms = 1;
+            cache.put(query, std::move(entry));
+        }
+    }
+    return 100.0 * cache.cache_hits / trace.size();
+}
+
+void run_policy_simulation()
+{
+    const int capacity = 100;
+    const int length = 100000;
+    std::vector<std::pair<std::string, std::function<CacheStrategy *()>>> policies = {
+        {"LIRS (legacy)", [&]() -> CacheStrategy *
+         { return new LIRSCache(capacity); }},
+        {"TinyFLU (legacy)", [&]() -> CacheStrategy *
+         { return new TinyFLUCache(capacity); }},
+        {"S3-FIFO", [&]() -> CacheStrategy *
+         { return new S3FIFOCache(capacity); }},
+        {"ARC", [&]() -> CacheStrategy *
+         { return new ARCCache(capacity); }},
+        {"CLOCK", [&]() -> CacheStrategy *
+         { return new CLOCKCache(capacity); }},
+        {"SIEVE", [&]() -> CacheStrategy *
+         { return new CLOCKCache(capacity, true); }},
+        {"CLOCK-Pro", [&]() -> CacheStrategy *
+         { return new CLOCKProCache(capacity); }},
+        {"Sampled-LRU", [&]() -> CacheStrategy *
+         { return new SampledCache(capacity); }},
+        {"Sampled-LFU", [&]() -> CacheStrategy *
+         { return new SampledCache(capacity, true); }},
+        {"Learned", [&]() -> CacheStrategy *
+         { return new LearnedCache(capacity); }},
+        {"LIRS stack", [&]() { return make_composed_cache("lirs-stack", capacity); }},
+        {"LIRS stack fixed", [&]() { return make_composed_cache("lirs-stack", capacity, false); }},
+        {"TinyLFU+S3FIFO", [&]() { return make_composed_cache("tinylfu+s3fifo", capacity); }},
+        {"TinyLFU+S3 fixed", [&]() { return make_composed_cache("tinylfu+s3fifo", capacity, false); }},
+        {"W-TinyLFU", [&]() { return make_composed_cache("w-tinylfu", capacity); }},
+        {"W-TinyLFU fixed", [&]() { return make_composed_cache("w-tinylfu", capacity, false); }},
+        {"TinyLFU+LRU", [&]() { return make_composed_cache("tinylfu+lru", capacity); }},
+        {"TinyLFU+LIRS", [&]() { return make_composed_cache("tinylfu+lirs", capacity); }},
+    };
+    for (double weight : {0.25, 0.5, 1.0})
+    {
+        std::ostringstream name;
+        name << "Hybrid w=" << weight;
+        policies.push_back({name.str(), [=]() -> CacheStrategy *
+                            {
+                                HybridCache *cache = new HybridCache(capacity);
+                                cache->admission_policy().frequency_weight = weight;
+                                return cache;
+                            }});
+    }
+
+    std::vector<std::string> kinds = {"zipf", "loop", "mixed", "shift"};
+    std::vector<std::vector<int>> traces;
+    for (const auto &kind : kinds)
+    {
+        traces.push_back(make_trace(kind, capacity, length));
+    }
+
+    std::cout << "Hit ratio (%), capacity " << capacity << ", " << length << " requests per trace\n";
+    std::cout << std::left << std::setw(18) << "Policy";
+    for (const auto &kind : kinds)
+    {
+        std::cout << std::right << std::setw(8) << kind;
+    }
+    std::cout << "\n";
+    for (const auto &policy : policies)
+    {
+        std::cout << std::left << std::setw(18) << policy.first << std::fixed << std::setprecision(2);
+        for (const auto &trace : traces)
+        {
+            std::unique_ptr<CacheStrategy> cache(policy.second());
+            std::cout << std::right << std::setw(8) << simulate(*cache, trace);
+        }
+        std::cout << std::defaultfloat << "\n";
+    }
+}
+
+// Replay trace from several threads against one strategy behind a reader/
+// writer lock. Hits take the lock shared when the policy allows it and
+// exclusive otherwise; misses always insert under the exclusive lock.
+// Returns lookups per second and sets hit_ratio (%).
+double simulate_concurrent(CacheStrategy &cache, const std::vector<int> &trace, int threads, double &hit_ratio)
+{
+    cache.verbose = false;
+    cache.admission_ratio = 0;
+    std::shared_mutex mutex;
+    std::atomic<long> hits(0);
+    bool shared = cache.shared_hits();
+    auto worker = [&](int id)
+    {
+        long local_hits = 0;
+        for (size_t i = id; i < trace.size(); i += threads)
+        {
+            std::string query = "q" + std::to_string(trace[i]);
+            bool hit;
+            if (shared)
+            {
+                std::shared_lock<std::shared_mutex> lock(mutex);
+                hit = cache.cache.count(query) > 0;
+                if (hit)
+                    cache.update(query);
+            }
+            else
+            {
+                std::unique_lock<std::shared_mutex> lock(mutex);
+                hit = cache.cache.count(query) > 0;
+                if (hit)
+                    cache.update(query);
+            }
+            if (hit)
+            {
+                local_hits++;
+                continue;
+            }
+            std::unique_lock<std::shared_mutex> lock(mutex);
+            if (!cache.cache.count(query))
+            {
+                CacheEntry entry;
+                entry.result = "r";
+                entry.cost_ms = 1;
+                cache.put(query, std::move(entry));
+            }
+        }
+        hits += local_hits;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (int id = 0; id < threads; id++)
+    {
+        pool.emplace_back(worker, id);
+    }
+    for (auto &thread : pool)
+    {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    hit_ratio = 100.0 * hits / trace.size();
+    return trace.size() / seconds;
+}
+
+// Compare lookup throughput of the list-reordering strategies with the
+// CLOCK family, whose hits never take the exclusive lock, on the zipf trace.
+void run_concurrency_simulation()
+{
+    const int capacity = 1000;
+    const int length = 400000;
+    std::vector<std::pair<std::string, std::function<CacheStrategy *()>>> policies = {
+        {"LIRS (legacy)", [&]() -> CacheStrategy *
+         { return new LIRSCache(capacity); }},
+        {"TinyFLU (legacy)", [&]() -> CacheStrategy *
+         { return new TinyFLUCache(capacity); }},
+        {"ARC", [&]() -> CacheStrategy *
+         { return new ARCCache(capacity); }},
+        {"TinyLFU+LRU", [&]() { return make_composed_cache("tinylfu+lru", capacity); }},
+        {"CLOCK", [&]() -> CacheStrategy *
+         { return new CLOCKCache(capacity); }},
+        {"SIEVE", [&]() -> CacheStrategy *
+         { return new CLOCKCache(capacity, true); }},
+        {"CLOCK-Pro", [&]() -> CacheStrategy *
+         { return new CLOCKProCache(capacity); }},
+    };
+    std::vector<int> trace = make_trace("zipf", capacity, length);
+    std::vector<int> thread_counts = {1, 2, 4, 8};
+
+    std::cout << "Lookups per second (thousands) on the zipf trace, capacity " << capacity << ", " << length << " requests\n";
+    std::cout << std::left << std::setw(18) << "Policy" << std::right << std::setw(8) << "hit %";
+    for (int threads : thread_counts)
+    {
+        std::cout << std::setw(8) << (std::to_string(threads) + "T");
+    }
+    std::cout << "\n";
+    for (const auto &policy : policies)
+    {
+        std::cout << std::left << std::setw(18) << policy.first << std::right << std::fixed << std::setprecision(2);
+        std::ostringstream row;
+        row << std::fixed << std::setprecision(0);
+        double hit_ratio = 0;
+        for (int threads : thread_counts)
+        {
+            std::unique_ptr<CacheStrategy> cache(policy.second());
+            row << std::setw(8) << simulate_concurrent(*cache, trace, threads, hit_ratio) / 1000;
+        }
+        std::cout << std::setw(8) << hit_ratio << row.str() << std::defaultfloat << "\n";
+    }
+}
+
 // Menu Driven Application
 
 void print_menu()
 {
     std::cout << "\n====== Database Management System Simulation ======\n";
-    std::cout << "1. Set Caching Strategy (LIRS, TinyFLU, S3-FIFO)\n";
+    std::cout << "1. Set Caching Strategy (LIRS, TinyFLU, S3-FIFO, GDSF, ARC, CLOCK, SIEVE, CLOCK-Pro, Sampled-LRU/LFU, Learned, Hybrid, Auto)\n";
     std::cout << "2. Enter and Process SQL Query\n";
     std::cout << "3. Run Benchmark Simulation\n";
     std::cout << "4. Show Cache Statistics\n";
     std::cout << "5. Exit\n";
+    std::cout << "6. Run Batched Benchmark Simulation\n";
+    std::cout << "7. Run Cache Policy Simulator\n";
+    std::cout << "8. Run Concurrent Lookup Benchmark\n";
+    std::cout << "9. Resize Cache\n";
     std::cout << "=====================================================\n";
 }
 
@@ -463,7 +6277,7 @@ int main()
 
         if (choice == "1")
         {
-            std::cout << "Enter caching strategy (LIRS/TinyFLU/S3-FIFO): ";
+            std::cout << "Enter caching strategy (LIRS/TinyFLU/S3-FIFO/GDSF/ARC/CLOCK/SIEVE/CLOCK-Pro/Sampled-LRU/Sampled-LFU/Learned/Auto, or a composition such as TinyLFU+S3FIFO, Size+LIRS): ";
             std::string strat;
             std::getline(std::cin, strat);
             db_system.set_cache_strategy(strat);
@@ -520,6 +6334,29 @@ int main()
         {
             db_system.show_cache_stats();
         }
+        else if (choice == "6")
+        {
+            db_system.run_batch_benchmark();
+        }
+        else if (choice == "7")
+        {
+            run_policy_simulation();
+        }
+        else if (choice == "8")
+        {
+            run_concurrency_simulation();
+        }
+        else if (choice == "9")
+        {
+            std::cout << "Enter new cache capacity (entries): ";
+            std::string size;
+            std::getline(std::cin, size);
+            int capacity = std::atoi(size.c_str());
+            if (capacity > 0)
+                db_system.resize_cache(capacity);
+            else
+                std::cout << "Invalid capacity.\n";
+        }
         else if (choice == "5")
         {
             std::cout << "Exiting simulation. Goodbye!\n";